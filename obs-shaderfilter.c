@@ -18,18 +18,135 @@
 #include <math.h>
 
 #include <util/threading.h>
+#include <util/crc32.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sys/time.h>
 #endif
+#include <sys/stat.h>
 
 #include "version.h"
+#include "shader-converter.h"
 
 float (*move_get_transition_filter)(obs_source_t *filter_from, obs_source_t **filter_to) = NULL;
 
+// Profiler scope names, shown in the OBS profiler log. libobs matches scopes by pointer, so these must stay unique.
+static const char *tick_name = "shader_filter_tick";
+static const char *update_name = "shader_filter_update";
+static const char *reload_effect_name = "shader_filter_reload_effect";
+static const char *load_file_name = "load_shader_file";
+static const char *expand_include_name = "expand_include";
+static const char *create_effect_name = "gs_effect_create";
+static const char *bind_params_name = "bind_effect_params";
+static const char *set_effect_params_name = "shader_filter_set_effect_params";
+static const char *get_input_source_name = "get_input_source";
+static const char *render_shader_name = "render_shader";
+static const char *draw_output_name = "draw_output";
+static const char *transition_render_name = "shader_transition_video_callback";
+static const char *texture_source_name = "render_texture_source";
+static const char *audio_capture_name = "audio_capture";
+static const char *frame_name = "frame";
+
+// Trace recorder: timed events from all instances go into a bounded ring that can be written out as a Chrome trace
+// (chrome://tracing, ui.perfetto.dev). When it is off, recording costs a single flag check per event.
+#define TRACE_RING 65536
+#define TRACE_DUMP_COOLDOWN_NS 10000000000ULL
+
+enum trace_thread {
+	TRACE_THREAD_GRAPHICS,
+	TRACE_THREAD_AUDIO,
+	TRACE_THREAD_SETTINGS,
+	TRACE_THREAD_COUNT,
+};
+
+static const char *trace_thread_names[TRACE_THREAD_COUNT] = {"graphics", "audio", "settings"};
+
+struct trace_event {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+	long instance;
+	enum trace_thread thread;
+};
+
+static volatile bool trace_enabled = false;
+static uint64_t trace_threshold_ns = 0;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_event *trace_events = NULL;
+static size_t trace_count = 0;
+static uint64_t trace_frame_time = 0;
+static uint64_t trace_frame_start = 0;
+static uint64_t trace_last_dump = 0;
+static volatile long trace_next_instance = 0;
+
+static inline uint64_t trace_begin(void)
+{
+	return trace_enabled ? os_gettime_ns() : 0;
+}
+
+// trace_mutex held.
+static void trace_push(const char *name, long instance, enum trace_thread thread, uint64_t start, uint64_t duration)
+{
+	if (!trace_events)
+		return;
+	struct trace_event *event = &trace_events[trace_count % TRACE_RING];
+	event->name = name;
+	event->start = start;
+	event->duration = duration;
+	event->instance = instance;
+	event->thread = thread;
+	trace_count++;
+}
+
+static void trace_end(const char *name, long instance, enum trace_thread thread, uint64_t start)
+{
+	if (!start || !trace_enabled)
+		return;
+	const uint64_t end = os_gettime_ns();
+	pthread_mutex_lock(&trace_mutex);
+	trace_push(name, instance, thread, start, end - start);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void trace_set_enabled(bool enabled, uint64_t threshold_ns)
+{
+	pthread_mutex_lock(&trace_mutex);
+	const bool changed = trace_enabled != enabled;
+	if (enabled && !trace_events) {
+		trace_events = bmalloc(sizeof(struct trace_event) * TRACE_RING);
+	} else if (!enabled) {
+		bfree(trace_events);
+		trace_events = NULL;
+	}
+	trace_count = 0;
+	trace_frame_time = 0;
+	trace_frame_start = 0;
+	trace_threshold_ns = threshold_ns;
+	trace_enabled = enabled;
+	pthread_mutex_unlock(&trace_mutex);
+	if (changed)
+		blog(LOG_INFO, "[obs-shaderfilter] Trace recording %s", enabled ? "enabled" : "disabled");
+}
+
 #define nullptr ((void *)0)
 
+#define IMAGE_STATS_SIZE 64
+#define IMAGE_STATS_LEVELS 4
+#define IMAGE_STATS_BLOCK_SAMPLES 64
+#define IMAGE_STATS_HISTOGRAM_GRID 128
+#define IMAGE_HISTORY_MAX 16
+#define AUDIO_LEVELS_RING 256
+// Same as the update interval of the OBS volume meter.
+#define AUDIO_MAGNITUDE_WINDOW_MS 50
+#define GPU_TIMER_PHASES 2
+#define GPU_TIMER_FRAMES 3
+#define GPU_TIMER_SAMPLES 120
+#define GPU_TIMER_LOG_INTERVAL_NS (60ULL * 1000000000ULL)
+#define STATS_SNAPSHOT_INTERVAL_NS 500000000ULL
+// Animated images larger than this when fully decoded keep decoding frame by frame.
+#define IMAGE_CACHE_PREDECODE_LIMIT (256ULL * 1024ULL * 1024ULL)
+
 static const char *effect_template_begin = "\
 uniform float4x4 ViewProj;\n\
 uniform texture2d image;\n\
@@ -117,6 +234,722 @@ technique Draw\n\
 	}\n\
 }\n";
 
+// Images used by texture parameters are shared between all filters through this cache. Decoding happens on a
+// worker thread, the texture is uploaded on the graphics thread the first time it is bound.
+struct image_cache_entry {
+	struct dstr path;
+	time_t mtime;
+	long refs;
+	volatile bool decoded;
+	bool uploaded;
+	bool queued;
+	gs_image_file_t image;
+	struct image_cache_entry *next;
+	struct image_cache_entry *next_pending;
+
+	// Animated images, advanced once per video frame from the filters' video_tick.
+	uint64_t last_tick;
+	bool predecode;
+	bool predecode_attempted;
+	volatile bool frames_decoded;
+	uint8_t **frame_data;
+	uint64_t *frame_delays;
+	size_t frame_count;
+	int loop_count;
+	gs_texture_t **frame_textures;
+	size_t cur_frame;
+	uint64_t cur_time;
+	int cur_loop;
+};
+
+static pthread_mutex_t image_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct image_cache_entry *image_cache = NULL;
+static struct image_cache_entry *image_cache_pending = NULL;
+static os_sem_t *image_cache_sem = NULL;
+static pthread_t image_cache_thread;
+static bool image_cache_thread_active = false;
+static volatile bool image_cache_stop = false;
+static struct image_sequence *image_sequences = NULL;
+// References handed over by image_release_deferred, dropped by the decode thread.
+static DARRAY(struct image_cache_entry *) image_cache_releases;
+static DARRAY(struct image_sequence *) image_sequence_releases;
+
+static time_t image_cache_get_mtime(const char *path)
+{
+	struct stat st;
+	if (os_stat(path, &st) != 0)
+		return 0;
+	return st.st_mtime;
+}
+
+static void image_cache_entry_destroy(struct image_cache_entry *entry)
+{
+	obs_enter_graphics();
+	gs_image_file_free(&entry->image);
+	if (entry->frame_textures) {
+		for (size_t i = 0; i < entry->frame_count; i++)
+			gs_texture_destroy(entry->frame_textures[i]);
+		bfree(entry->frame_textures);
+	}
+	obs_leave_graphics();
+	if (entry->frame_data) {
+		for (size_t i = 0; i < entry->frame_count; i++)
+			bfree(entry->frame_data[i]);
+		bfree(entry->frame_data);
+	}
+	bfree(entry->frame_delays);
+	dstr_free(&entry->path);
+	bfree(entry);
+}
+
+// Decodes every frame of an animated image up front from a private copy of the file, so the shared image is never
+// touched off the graphics thread. The frames are turned into textures the next time the image is bound.
+static void image_cache_predecode(struct image_cache_entry *entry)
+{
+	gs_image_file_t image;
+	gs_image_file_init(&image, entry->path.array);
+	if (image.loaded && image.is_animated_gif) {
+		const size_t frame_size = (size_t)image.cx * image.cy * 4;
+		const size_t frame_count = image.gif.frame_count;
+		if ((uint64_t)frame_size * frame_count > IMAGE_CACHE_PREDECODE_LIMIT) {
+			blog(LOG_INFO, "[obs-shaderfilter] '%s' is too large to pre-decode (%zu frames), decoding per frame",
+			     entry->path.array, frame_count);
+		} else {
+			uint8_t **frame_data = bzalloc(sizeof(uint8_t *) * frame_count);
+			uint64_t *frame_delays = bzalloc(sizeof(uint64_t) * frame_count);
+			size_t decoded = 0;
+			for (; decoded < frame_count; decoded++) {
+				if (gif_decode_frame(&image.gif, (unsigned int)decoded) != GIF_OK)
+					break;
+				frame_data[decoded] = bmemdup(image.gif.frame_image, frame_size);
+				// Same minimum frame delay libobs applies to GIFs.
+				unsigned int delay = image.gif.frames[decoded].frame_delay;
+				frame_delays[decoded] = (uint64_t)(delay < 2 ? 10 : delay) * 10000000ULL;
+			}
+			if (decoded == frame_count) {
+				entry->frame_data = frame_data;
+				entry->frame_delays = frame_delays;
+				entry->frame_count = frame_count;
+				entry->loop_count = image.gif.loop_count;
+				os_atomic_set_bool(&entry->frames_decoded, true);
+			} else {
+				blog(LOG_WARNING, "[obs-shaderfilter] Unable to pre-decode frame %zu of '%s', decoding per frame",
+				     decoded, entry->path.array);
+				for (size_t i = 0; i < decoded; i++)
+					bfree(frame_data[i]);
+				bfree(frame_data);
+				bfree(frame_delays);
+			}
+		}
+	}
+	obs_enter_graphics();
+	gs_image_file_free(&image);
+	obs_leave_graphics();
+}
+
+static void image_cache_release(struct image_cache_entry *entry)
+{
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	bool last = --entry->refs == 0;
+	if (last) {
+		struct image_cache_entry **prev = &image_cache;
+		while (*prev && *prev != entry)
+			prev = &(*prev)->next;
+		if (*prev)
+			*prev = entry->next;
+	}
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	if (last)
+		image_cache_entry_destroy(entry);
+}
+
+// Texture parameters with widget_type "sequence" play a directory or numbered sequence of images. Only a small ring
+// of decoded frames ahead of the playhead is kept in memory, filled by the image decode thread.
+#define IMAGE_SEQUENCE_RING 8
+
+struct image_sequence_frame {
+	uint8_t *data;
+	enum gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+	long index;
+};
+
+struct image_sequence {
+	DARRAY(char *) files;
+	double fps;
+	bool loop;
+	double time;
+	volatile long playhead;
+
+	// Guarded by image_cache_mutex, the decode thread holds a reference while it decodes.
+	long refs;
+	struct image_sequence *next;
+
+	pthread_mutex_t mutex;
+	struct image_sequence_frame frames[IMAGE_SEQUENCE_RING];
+
+	gs_texture_t *texture;
+	long texture_index;
+};
+
+static bool image_sequence_is_image(const char *file)
+{
+	const char *ext = os_get_path_extension(file);
+	if (!ext)
+		return false;
+	return astrcmpi(ext, ".png") == 0 || astrcmpi(ext, ".jpg") == 0 || astrcmpi(ext, ".jpeg") == 0 ||
+	       astrcmpi(ext, ".bmp") == 0 || astrcmpi(ext, ".tga") == 0;
+}
+
+static int image_sequence_compare(const void *a, const void *b)
+{
+	return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// A directory plays every image in it, a file plays every file next to it with the same name apart from the trailing
+// frame number, e.g. frame_0001.png selects frame_*.png.
+static void image_sequence_find_files(struct image_sequence *sequence, const char *path)
+{
+	struct dstr dir = {0};
+	struct dstr prefix = {0};
+	const char *ext = NULL;
+	if (os_file_exists(path) && !image_sequence_is_image(path)) {
+		dstr_copy(&dir, path);
+	} else {
+		const char *slash = strrchr(path, '/');
+		const char *backslash = strrchr(path, '\\');
+		if (backslash && (!slash || backslash > slash))
+			slash = backslash;
+		const char *file = slash ? slash + 1 : path;
+		dstr_ncopy(&dir, path, file - path);
+		ext = os_get_path_extension(file);
+		const char *digits = ext ? ext : file + strlen(file);
+		while (digits > file && *(digits - 1) >= '0' && *(digits - 1) <= '9')
+			digits--;
+		dstr_ncopy(&prefix, file, digits - file);
+	}
+	if (dir.len && dstr_end(&dir) != '/' && dstr_end(&dir) != '\\')
+		dstr_cat_ch(&dir, '/');
+
+	os_dir_t *d = os_opendir(dir.len ? dir.array : ".");
+	if (d) {
+		struct os_dirent *ent;
+		while ((ent = os_readdir(d)) != NULL) {
+			if (ent->directory || !image_sequence_is_image(ent->d_name))
+				continue;
+			if (ext) {
+				const char *ent_ext = os_get_path_extension(ent->d_name);
+				if (!ent_ext || astrcmpi(ent_ext, ext) != 0 || strncmp(ent->d_name, prefix.array, prefix.len) != 0)
+					continue;
+			}
+			struct dstr file = {0};
+			dstr_copy_dstr(&file, &dir);
+			dstr_cat(&file, ent->d_name);
+			da_push_back(sequence->files, &file.array);
+		}
+		os_closedir(d);
+	}
+	if (sequence->files.num)
+		qsort(sequence->files.array, sequence->files.num, sizeof(char *), image_sequence_compare);
+
+	dstr_free(&dir);
+	dstr_free(&prefix);
+}
+
+static long image_sequence_wrap(struct image_sequence *sequence, long index)
+{
+	const long count = (long)sequence->files.num;
+	if (sequence->loop)
+		return index % count;
+	return index < count ? index : count - 1;
+}
+
+static void image_sequence_free(struct image_sequence *sequence)
+{
+	pthread_mutex_destroy(&sequence->mutex);
+	for (size_t i = 0; i < IMAGE_SEQUENCE_RING; i++)
+		bfree(sequence->frames[i].data);
+	for (size_t i = 0; i < sequence->files.num; i++)
+		bfree(sequence->files.array[i]);
+	da_free(sequence->files);
+
+	obs_enter_graphics();
+	gs_texture_destroy(sequence->texture);
+	obs_leave_graphics();
+	bfree(sequence);
+}
+
+static void image_sequence_release(struct image_sequence *sequence)
+{
+	pthread_mutex_lock(&image_cache_mutex);
+	const bool last = --sequence->refs == 0;
+	pthread_mutex_unlock(&image_cache_mutex);
+	if (last)
+		image_sequence_free(sequence);
+}
+
+// Decode thread. Decodes the nearest frame in the window ahead of the playhead that is not in the ring yet, returns
+// false when the window is already complete.
+static bool image_sequence_decode_next(struct image_sequence *sequence)
+{
+	const long playhead = os_atomic_load_long(&sequence->playhead);
+	uint32_t claimed = 0;
+	for (long ahead = 0; ahead < IMAGE_SEQUENCE_RING; ahead++) {
+		const long index = image_sequence_wrap(sequence, playhead + ahead);
+		// Stop where the window wraps onto a slot that is already holding an earlier frame.
+		const uint32_t slot = 1u << (index % IMAGE_SEQUENCE_RING);
+		if (claimed & slot)
+			break;
+		claimed |= slot;
+		struct image_sequence_frame *frame = &sequence->frames[index % IMAGE_SEQUENCE_RING];
+		pthread_mutex_lock(&sequence->mutex);
+		const bool present = frame->index == index;
+		pthread_mutex_unlock(&sequence->mutex);
+		if (present)
+			continue;
+
+		struct image_sequence_frame next = {0};
+		next.index = index;
+		next.data = gs_create_texture_file_data(sequence->files.array[index], &next.format, &next.cx, &next.cy);
+		if (!next.data)
+			blog(LOG_WARNING, "[obs-shaderfilter] Unable to load image '%s'", sequence->files.array[index]);
+
+		pthread_mutex_lock(&sequence->mutex);
+		uint8_t *old_data = frame->data;
+		*frame = next;
+		pthread_mutex_unlock(&sequence->mutex);
+		bfree(old_data);
+		return true;
+	}
+	return false;
+}
+
+// Decode thread. Decodes one frame for every sequence that still needs one, so a long sequence never starves the
+// others. Returns false once every window is complete.
+static bool image_sequences_decode_pass(void)
+{
+	DARRAY(struct image_sequence *) sequences;
+	da_init(sequences);
+	pthread_mutex_lock(&image_cache_mutex);
+	for (struct image_sequence *sequence = image_sequences; sequence; sequence = sequence->next) {
+		sequence->refs++;
+		da_push_back(sequences, &sequence);
+	}
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	bool decoded = false;
+	for (size_t i = 0; i < sequences.num; i++) {
+		if (!os_atomic_load_bool(&image_cache_stop))
+			decoded |= image_sequence_decode_next(sequences.array[i]);
+		image_sequence_release(sequences.array[i]);
+	}
+	da_free(sequences);
+	return decoded;
+}
+
+static void image_sequence_destroy(struct image_sequence *sequence);
+
+// Decode thread, or image_cache_shutdown once the thread has stopped.
+static void image_cache_process_releases(void)
+{
+	DARRAY(struct image_cache_entry *) images;
+	DARRAY(struct image_sequence *) sequences;
+	da_init(images);
+	da_init(sequences);
+	pthread_mutex_lock(&image_cache_mutex);
+	da_move(images, image_cache_releases);
+	da_move(sequences, image_sequence_releases);
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	for (size_t i = 0; i < images.num; i++)
+		image_cache_release(images.array[i]);
+	for (size_t i = 0; i < sequences.num; i++)
+		image_sequence_destroy(sequences.array[i]);
+	da_free(images);
+	da_free(sequences);
+}
+
+static bool image_cache_has_pending(void)
+{
+	pthread_mutex_lock(&image_cache_mutex);
+	const bool pending = image_cache_pending != NULL;
+	pthread_mutex_unlock(&image_cache_mutex);
+	return pending;
+}
+
+static void *image_cache_thread_func(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("shaderfilter: image decode");
+
+	while (os_sem_wait(image_cache_sem) == 0) {
+		if (os_atomic_load_bool(&image_cache_stop))
+			break;
+
+		image_cache_process_releases();
+
+		pthread_mutex_lock(&image_cache_mutex);
+		struct image_cache_entry *entry = image_cache_pending;
+		bool predecode = false;
+		if (entry) {
+			image_cache_pending = entry->next_pending;
+			entry->queued = false;
+			predecode = entry->predecode && !entry->predecode_attempted;
+			entry->predecode_attempted |= predecode;
+		}
+		// Skip the decode when nobody is left waiting for it.
+		const bool wanted = entry && entry->refs > 1;
+		pthread_mutex_unlock(&image_cache_mutex);
+
+		if (entry) {
+			if (wanted && !os_atomic_load_bool(&entry->decoded)) {
+				gs_image_file_init(&entry->image, entry->path.array);
+				if (!entry->image.loaded)
+					blog(LOG_WARNING, "[obs-shaderfilter] Unable to load image '%s'", entry->path.array);
+				os_atomic_set_bool(&entry->decoded, true);
+			}
+			if (wanted && predecode)
+				image_cache_predecode(entry);
+			image_cache_release(entry);
+		}
+
+		// Sequence frames are decoded between images, until every ring is filled or another image is queued.
+		while (!os_atomic_load_bool(&image_cache_stop) && !image_cache_has_pending() && image_sequences_decode_pass())
+			;
+	}
+	return NULL;
+}
+
+// Caller holds image_cache_mutex.
+static bool image_cache_start_thread(void)
+{
+	if (image_cache_thread_active)
+		return true;
+	os_atomic_set_bool(&image_cache_stop, false);
+	if (os_sem_init(&image_cache_sem, 0) == 0 &&
+	    pthread_create(&image_cache_thread, NULL, image_cache_thread_func, NULL) == 0) {
+		image_cache_thread_active = true;
+	} else {
+		blog(LOG_ERROR, "[obs-shaderfilter] Unable to start image decode thread");
+		os_sem_destroy(image_cache_sem);
+		image_cache_sem = NULL;
+	}
+	return image_cache_thread_active;
+}
+
+// Caller holds image_cache_mutex and posts image_cache_sem after unlocking.
+static void image_cache_queue(struct image_cache_entry *entry)
+{
+	if (entry->queued)
+		return;
+	entry->queued = true;
+	entry->refs++;
+	struct image_cache_entry **last = &image_cache_pending;
+	while (*last)
+		last = &(*last)->next_pending;
+	*last = entry;
+}
+
+static struct image_cache_entry *image_cache_acquire(const char *path, bool predecode, bool *hit)
+{
+	if (!path || !*path)
+		return NULL;
+
+	const time_t mtime = image_cache_get_mtime(path);
+
+	pthread_mutex_lock(&image_cache_mutex);
+	struct image_cache_entry *entry = image_cache;
+	while (entry && (entry->mtime != mtime || strcmp(entry->path.array, path) != 0))
+		entry = entry->next;
+	*hit = entry != NULL;
+	if (entry) {
+		entry->refs++;
+		const bool queue = predecode && !entry->predecode && image_cache_thread_active;
+		entry->predecode |= predecode;
+		if (queue)
+			image_cache_queue(entry);
+		pthread_mutex_unlock(&image_cache_mutex);
+		if (queue)
+			os_sem_post(image_cache_sem);
+		return entry;
+	}
+
+	image_cache_start_thread();
+
+	entry = bzalloc(sizeof(struct image_cache_entry));
+	dstr_copy(&entry->path, path);
+	entry->mtime = mtime;
+	entry->predecode = predecode;
+	entry->refs = 1;
+	entry->next = image_cache;
+	image_cache = entry;
+
+	if (image_cache_thread_active) {
+		image_cache_queue(entry);
+		pthread_mutex_unlock(&image_cache_mutex);
+		os_sem_post(image_cache_sem);
+	} else {
+		entry->predecode_attempted = predecode;
+		pthread_mutex_unlock(&image_cache_mutex);
+		gs_image_file_init(&entry->image, path);
+		os_atomic_set_bool(&entry->decoded, true);
+		if (predecode)
+			image_cache_predecode(entry);
+	}
+	return entry;
+}
+
+// Graphics thread only. Returns NULL until the image has been decoded.
+static gs_texture_t *image_cache_get_texture(struct image_cache_entry *entry)
+{
+	if (!entry || !os_atomic_load_bool(&entry->decoded))
+		return NULL;
+	if (!entry->uploaded) {
+		gs_image_file_init_texture(&entry->image);
+		entry->uploaded = true;
+	}
+	if (!entry->frame_textures && os_atomic_load_bool(&entry->frames_decoded)) {
+		entry->frame_textures = bzalloc(sizeof(gs_texture_t *) * entry->frame_count);
+		for (size_t i = 0; i < entry->frame_count; i++) {
+			entry->frame_textures[i] = gs_texture_create(entry->image.cx, entry->image.cy, GS_RGBA, 1,
+								     (const uint8_t **)&entry->frame_data[i], 0);
+			bfree(entry->frame_data[i]);
+		}
+		bfree(entry->frame_data);
+		entry->frame_data = NULL;
+	}
+	if (entry->frame_textures)
+		return entry->frame_textures[entry->cur_frame];
+	return entry->image.texture;
+}
+
+// Graphics context held. Shared images are advanced once per video frame no matter how many filters use them.
+static void image_cache_tick(struct image_cache_entry *entry, uint64_t frame_time)
+{
+	if (!entry || !entry->uploaded || !entry->image.is_animated_gif || entry->last_tick == frame_time)
+		return;
+	const uint64_t elapsed = entry->last_tick ? frame_time - entry->last_tick : 0;
+	entry->last_tick = frame_time;
+
+	if (!entry->frame_textures) {
+		// Streaming decode, only uploads when the frame changed.
+		if (gs_image_file_tick(&entry->image, elapsed))
+			gs_image_file_update_texture(&entry->image);
+		return;
+	}
+
+	if (entry->loop_count > 0 && entry->cur_loop >= entry->loop_count)
+		return;
+	entry->cur_time += elapsed;
+	while (entry->cur_time >= entry->frame_delays[entry->cur_frame]) {
+		entry->cur_time -= entry->frame_delays[entry->cur_frame];
+		if (++entry->cur_frame < entry->frame_count)
+			continue;
+		if (entry->loop_count > 0 && ++entry->cur_loop >= entry->loop_count) {
+			entry->cur_frame = entry->frame_count - 1;
+			break;
+		}
+		entry->cur_frame = 0;
+	}
+}
+
+static void image_cache_shutdown(void)
+{
+	if (!image_cache_thread_active)
+		return;
+
+	os_atomic_set_bool(&image_cache_stop, true);
+	os_sem_post(image_cache_sem);
+	pthread_join(image_cache_thread, NULL);
+	os_sem_destroy(image_cache_sem);
+	image_cache_sem = NULL;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	image_cache_thread_active = false;
+	struct image_cache_entry *pending = image_cache_pending;
+	image_cache_pending = NULL;
+	pthread_mutex_unlock(&image_cache_mutex);
+	image_cache_process_releases();
+	while (pending) {
+		struct image_cache_entry *next = pending->next_pending;
+		image_cache_release(pending);
+		pending = next;
+	}
+}
+
+// The decode thread may still be decoding a frame, whichever side lets go last frees the sequence.
+static void image_sequence_destroy(struct image_sequence *sequence)
+{
+	if (!sequence)
+		return;
+	pthread_mutex_lock(&image_cache_mutex);
+	struct image_sequence **prev = &image_sequences;
+	while (*prev && *prev != sequence)
+		prev = &(*prev)->next;
+	if (*prev)
+		*prev = sequence->next;
+	pthread_mutex_unlock(&image_cache_mutex);
+	image_sequence_release(sequence);
+}
+
+// Lets go of an image and a sequence on the decode thread, so the caller never waits for the graphics lock to free their
+// textures. Released right away when the thread is not running.
+static void image_release_deferred(struct image_cache_entry *image, struct image_sequence *sequence)
+{
+	if (!image && !sequence)
+		return;
+	pthread_mutex_lock(&image_cache_mutex);
+	const bool deferred = image_cache_thread_active;
+	if (deferred && image)
+		da_push_back(image_cache_releases, &image);
+	if (deferred && sequence)
+		da_push_back(image_sequence_releases, &sequence);
+	pthread_mutex_unlock(&image_cache_mutex);
+	if (deferred) {
+		os_sem_post(image_cache_sem);
+		return;
+	}
+	image_cache_release(image);
+	image_sequence_destroy(sequence);
+}
+
+static struct image_sequence *image_sequence_create(const char *path, double fps, bool loop)
+{
+	if (!path || !*path)
+		return NULL;
+
+	struct image_sequence *sequence = bzalloc(sizeof(struct image_sequence));
+	da_init(sequence->files);
+	image_sequence_find_files(sequence, path);
+	if (!sequence->files.num) {
+		blog(LOG_WARNING, "[obs-shaderfilter] No images found for sequence '%s'", path);
+		da_free(sequence->files);
+		bfree(sequence);
+		return NULL;
+	}
+	sequence->fps = fps > 0.0 ? fps : 30.0;
+	sequence->loop = loop;
+	sequence->texture_index = -1;
+	sequence->refs = 1;
+	for (size_t i = 0; i < IMAGE_SEQUENCE_RING; i++)
+		sequence->frames[i].index = -1;
+	pthread_mutex_init(&sequence->mutex, NULL);
+
+	pthread_mutex_lock(&image_cache_mutex);
+	const bool started = image_cache_start_thread();
+	if (started) {
+		sequence->next = image_sequences;
+		image_sequences = sequence;
+	}
+	pthread_mutex_unlock(&image_cache_mutex);
+	if (!started) {
+		image_sequence_free(sequence);
+		return NULL;
+	}
+	os_sem_post(image_cache_sem);
+	return sequence;
+}
+
+static void image_sequence_tick(struct image_sequence *sequence, float seconds)
+{
+	if (!sequence)
+		return;
+	sequence->time += seconds;
+	const long index = image_sequence_wrap(sequence, (long)(sequence->time * sequence->fps));
+	if (os_atomic_set_long(&sequence->playhead, index) != index)
+		os_sem_post(image_cache_sem);
+}
+
+// Graphics thread only. Keeps showing the last uploaded frame while the current one is still decoding.
+static gs_texture_t *image_sequence_get_texture(struct image_sequence *sequence)
+{
+	if (!sequence)
+		return NULL;
+	const long index = os_atomic_load_long(&sequence->playhead);
+	if (index == sequence->texture_index)
+		return sequence->texture;
+
+	struct image_sequence_frame *frame = &sequence->frames[index % IMAGE_SEQUENCE_RING];
+	pthread_mutex_lock(&sequence->mutex);
+	if (frame->index == index && frame->data) {
+		if (!sequence->texture || gs_texture_get_width(sequence->texture) != frame->cx ||
+		    gs_texture_get_height(sequence->texture) != frame->cy ||
+		    gs_texture_get_color_format(sequence->texture) != frame->format) {
+			gs_texture_destroy(sequence->texture);
+			sequence->texture = gs_texture_create(frame->cx, frame->cy, frame->format, 1,
+							      (const uint8_t **)&frame->data, GS_DYNAMIC);
+		} else {
+			gs_texture_set_image(sequence->texture, frame->data, frame->cx * gs_get_format_bpp(frame->format) / 8,
+					     false);
+		}
+		sequence->texture_index = index;
+	}
+	pthread_mutex_unlock(&sequence->mutex);
+	return sequence->texture;
+}
+
+#define AUDIO_BEAT_BANDS 3
+#define AUDIO_BEAT_INTERVALS 8
+#define AUDIO_BEAT_REFRACTORY_NS 250000000ULL
+#define AUDIO_BEAT_MIN_INTERVAL_NS 270000000ULL
+#define AUDIO_BEAT_MAX_INTERVAL_NS 1500000000ULL
+
+struct audio_beat {
+	uint32_t sample_rate;
+	float b0[AUDIO_BEAT_BANDS], b1[AUDIO_BEAT_BANDS], b2[AUDIO_BEAT_BANDS], a1[AUDIO_BEAT_BANDS], a2[AUDIO_BEAT_BANDS];
+	float z1[AUDIO_BEAT_BANDS], z2[AUDIO_BEAT_BANDS];
+
+	float energy_mean;
+	float energy_var;
+	uint64_t last_onset;
+	uint64_t intervals[AUDIO_BEAT_INTERVALS];
+	size_t interval_count;
+	size_t interval_pos;
+	float period;
+};
+
+enum gpu_timer_phase {
+	GPU_TIMER_SHADER,
+	GPU_TIMER_OUTPUT,
+};
+
+struct gpu_timer {
+	gs_timer_range_t *ranges[GPU_TIMER_FRAMES];
+	gs_timer_t *timers[GPU_TIMER_FRAMES][GPU_TIMER_PHASES];
+	bool used[GPU_TIMER_FRAMES][GPU_TIMER_PHASES];
+	bool pending[GPU_TIMER_FRAMES];
+	size_t frame;
+	bool active;
+	uint64_t last_log;
+
+	pthread_mutex_t mutex;
+	float samples[GPU_TIMER_PHASES][GPU_TIMER_SAMPLES];
+	size_t sample_count[GPU_TIMER_PHASES];
+	size_t sample_pos[GPU_TIMER_PHASES];
+};
+
+// Levels of one audio buffer, written by the audio capture callback and read by video_tick.
+struct audio_levels {
+	uint64_t timestamp;
+	float peak;
+	float magnitude;
+	float bass;
+	float mid;
+	float treble;
+	uint64_t last_onset;
+	float beat_period;
+};
+
+struct param_pair {
+	size_t from;
+	size_t to;
+};
+
 struct effect_param_data {
 	struct dstr name;
 	struct dstr display_name;
@@ -129,7 +962,10 @@ struct effect_param_data {
 	enum gs_shader_param_type type;
 	gs_eparam_t *param;
 
-	gs_image_file_t *image;
+	struct image_cache_entry *image;
+	struct image_sequence *sequence;
+	double sequence_fps;
+	bool sequence_loop;
 	gs_texrender_t *render;
 	obs_weak_source_t *source;
 
@@ -170,17 +1006,40 @@ struct shader_filter_data {
 	gs_effect_t *effect;
 	gs_effect_t *output_effect;
 	gs_vertbuffer_t *sprite_buffer;
+	// Keyed on the target's trace_id, a new filter can reuse the address of a destroyed one.
+	long lerp_target_id;
+	long lerp_generation;
+	long lerp_target_generation;
+	DARRAY(struct param_pair) lerp_pairs;
+	int sprite_width;
+	int sprite_height;
 
 	gs_texrender_t *input_texrender;
 	gs_texrender_t *previous_input_texrender;
 	gs_texrender_t *output_texrender;
 	gs_texrender_t *previous_output_texrender;
+	gs_texrender_t *history[IMAGE_HISTORY_MAX];
+	int history_depth;
+	int history_head;
+	int history_downscale;
 	gs_eparam_t *param_output_image;
 
 	bool reload_effect;
+	// First compile postponed by lazy compile (see shader_filter_defer_compile) or resources released by idle eviction
+	// (see shader_filter_evict), both restored by shader_filter_compile_deferred from the tick.
+	volatile bool compile_deferred;
+	bool compile_requested;
+	bool evicted;
+	uint64_t hidden_since;
+	long evictions;
+	// VRAM_RELEASE_* flags set by vram_budget_tick, handled by the filter's own tick. Video thread only.
+	int vram_release;
+	uint64_t last_render_time;
 	struct dstr last_path;
 	bool last_from_file;
 	bool transition;
+	// Benchmark and batch render sources, see shader_filter_initial_update.
+	bool offline;
 	bool transitioning;
 	bool prev_transitioning;
 
@@ -226,8 +1085,29 @@ struct shader_filter_data {
 	gs_eparam_t *param_transition_time;
 	gs_eparam_t *param_convert_linear;
 	gs_eparam_t *param_previous_output;
+	gs_eparam_t *param_image_history[IMAGE_HISTORY_MAX];
 	gs_eparam_t *param_audio_peak;
+	gs_eparam_t *param_audio_beat;
+	gs_eparam_t *param_audio_beat_phase;
+	gs_eparam_t *param_audio_bpm;
+	gs_eparam_t *param_audio_bass;
+	gs_eparam_t *param_audio_mid;
+	gs_eparam_t *param_audio_treble;
 	gs_eparam_t *param_audio_magnitude;
+	gs_eparam_t *param_audio_spectrum;
+	gs_eparam_t *param_image_avg_luma;
+	gs_eparam_t *param_image_min_max;
+	gs_eparam_t *param_image_histogram;
+
+	// Shared by all filters, see image_stats_acquire.
+	gs_effect_t *stats_effect;
+	gs_texrender_t *stats_levels[IMAGE_STATS_LEVELS];
+	gs_texrender_t *stats_histogram;
+	gs_stagesurf_t *stats_stagesurf[2];
+	bool stats_staged[2];
+	size_t stats_frame;
+	float image_avg_luma;
+	struct vec2 image_min_max;
 
 	int expand_left;
 	int expand_right;
@@ -236,6 +1116,15 @@ struct shader_filter_data {
 
 	int total_width;
 	int total_height;
+	// Tiled rendering for outputs larger than one texture, see shader_filter_set_size.
+	int tile_size;
+	bool tiled;
+	int tile_extent;
+	int tile_columns;
+	int tile_rows;
+	int input_width;
+	int input_height;
+	DARRAY(gs_texrender_t *) output_tiles;
 	bool no_repeat;
 	bool rendering;
 
@@ -251,12 +1140,89 @@ struct shader_filter_data {
 	float rand_instance_f;
 	float rand_activation_f;
 	float audio_peak;
+	float audio_bass;
+	float audio_mid;
+	float audio_treble;
+	float audio_beat_value;
+	float audio_beat_phase;
+	float audio_bpm;
 	float audio_magnitude;
 
+	// Deterministic mode and input recording/replay, see input_stream_begin_tick.
+	uint64_t rng;
+	long deterministic_generation;
+	uint64_t deterministic_frame;
+	bool clock_override;
+	int64_t clock_ms;
+	volatile bool input_stream_active;
+	FILE *record_file;
+	FILE *replay_file;
+	struct input_record *replay_record;
+
+	struct dstr shader_body;
+	long effect_generation;
+	bool fuse_filters;
+	bool predecode_images;
+	bool gpu_timing;
+	struct gpu_timer *gpu_timer;
+	struct output_capture *capture;
+
+	// Reported by the shader_filter_get_stats proc handler.
+	struct dstr shader_id;
+	uint64_t compile_time_ns;
+	long image_cache_hits;
+	long image_cache_misses;
+	uint64_t frames_rendered;
+	uint64_t frames_skipped;
+	long trace_id;
+
+	// CPU time of tick and render on the graphics thread, and the allocations made by them when an allocation counter
+	// is registered (see alloc_counter). Totals since creation, plus the per-frame average of the last
+	// CPU_STATS_WINDOW ticks.
+	uint64_t cpu_time_ns;
+	long long cpu_allocs;
+	uint64_t cpu_frames;
+	uint64_t cpu_window_ns;
+	long long cpu_window_allocs;
+	uint32_t cpu_window_frames;
+	double cpu_us_per_frame;
+	double allocs_per_frame;
+	uint64_t update_time_ns;
+	uint64_t update_count;
+	obs_data_t *stats_snapshot;
+	uint64_t stats_snapshot_time;
+	uint64_t stats_snapshot_vram;
+	bool fuse_active;
+	bool fuse_compatible;
+	long fuse_checked_generation;
+	uint64_t fuse_signature;
+	uint64_t fuse_time;
+	struct shader_filter_data *fuse;
+	DARRAY(struct effect_param_data *) fuse_bindings;
+	DARRAY(obs_source_t *) fuse_sources;
+	DARRAY(struct shader_filter_data *) fuse_stage_builtins;
+
 	char *audio_source_name;
-	obs_volmeter_t *volmeter;
-	float current_audio_peak;
-	float current_audio_magnitude;
+	struct audio_levels audio_levels[AUDIO_LEVELS_RING];
+	volatile long audio_levels_written;
+	float audio_attack;
+	float audio_release;
+	volatile bool audio_beats;
+	// Whether the audio thread and the video tick had beat detection running, to start it from a clean state.
+	bool audio_beats_running;
+	bool audio_beats_ticking;
+	struct audio_beat audio_beat;
+	float *audio_mono;
+	uint32_t audio_mono_size;
+	uint32_t audio_channels;
+	uint32_t audio_sample_rate;
+	float audio_window_sum[MAX_AV_PLANES];
+	uint32_t audio_window_frames;
+	float audio_window_magnitude;
+	uint64_t audio_last_onset;
+	obs_weak_source_t *audio_capture;
+	struct audio_spectrum *audio_spectrum;
+	bool audio_spectrum_log;
 
 	DARRAY(struct effect_param_data) stored_param_list;
 };
@@ -294,6 +1260,7 @@ static char *load_shader_from_file(const char *file_name) // add input of visite
 		char *line = lines[line_i];
 		line_i++;
 		if (strncmp(line, "#include", 8) == 0) {
+			profile_start(expand_include_name);
 			// Open the included file, place contents here.
 			char *pos = strrchr(file_name, '/');
 			const size_t length = pos - file_name + 1;
@@ -310,6 +1277,7 @@ static char *load_shader_from_file(const char *file_name) // add input of visite
 			bfree(abs_include_path);
 			bfree(file_contents);
 			dstr_free(&include_path);
+			profile_end(expand_include_name);
 		} else {
 			// else place current line here.
 			dstr_cat(&shader_file, line);
@@ -362,7 +1330,17 @@ static void shader_filter_clear_params(struct shader_filter_data *filter)
 	filter->param_loop_second = NULL;
 	filter->param_local_time = NULL;
 	filter->param_audio_peak = NULL;
+	filter->param_audio_beat = NULL;
+	filter->param_audio_beat_phase = NULL;
+	filter->param_audio_bpm = NULL;
+	filter->param_audio_bass = NULL;
+	filter->param_audio_mid = NULL;
+	filter->param_audio_treble = NULL;
 	filter->param_audio_magnitude = NULL;
+	filter->param_audio_spectrum = NULL;
+	filter->param_image_avg_luma = NULL;
+	filter->param_image_min_max = NULL;
+	filter->param_image_histogram = NULL;
 	filter->param_image = NULL;
 	filter->param_previous_image = NULL;
 	filter->param_image_a = NULL;
@@ -370,18 +1348,22 @@ static void shader_filter_clear_params(struct shader_filter_data *filter)
 	filter->param_transition_time = NULL;
 	filter->param_convert_linear = NULL;
 	filter->param_previous_output = NULL;
+	for (size_t i = 0; i < IMAGE_HISTORY_MAX; i++)
+		filter->param_image_history[i] = NULL;
+	filter->history_depth = 0;
+	filter->history_downscale = 1;
 
 	size_t param_count = filter->stored_param_list.num;
 	for (size_t param_index = 0; param_index < param_count; param_index++) {
 		struct effect_param_data *param = (filter->stored_param_list.array + param_index);
 		if (param->image) {
-			obs_enter_graphics();
-			gs_image_file_free(param->image);
-			obs_leave_graphics();
-
-			bfree(param->image);
+			image_cache_release(param->image);
 			param->image = NULL;
 		}
+		if (param->sequence) {
+			image_sequence_destroy(param->sequence);
+			param->sequence = NULL;
+		}
 		if (param->source) {
 			obs_source_t *source = obs_weak_source_get_source(param->source);
 			if (source) {
@@ -415,19 +1397,13 @@ static void shader_filter_clear_params(struct shader_filter_data *filter)
 	da_free(filter->stored_param_list);
 }
 
-static void load_output_effect(struct shader_filter_data *filter)
+static gs_effect_t *load_internal_effect(const char *effect_name)
 {
-	if (filter->output_effect != NULL) {
-		obs_enter_graphics();
-		gs_effect_destroy(filter->output_effect);
-		filter->output_effect = NULL;
-		obs_leave_graphics();
-	}
-
 	char *shader_text = NULL;
 	struct dstr filename = {0};
 	dstr_cat(&filename, obs_get_module_data_path(obs_current_module()));
-	dstr_cat(&filename, "/internal/render_output.effect");
+	dstr_cat(&filename, "/internal/");
+	dstr_cat(&filename, effect_name);
 	char *abs_path = os_get_abs_path_ptr(filename.array);
 	if (abs_path) {
 		shader_text = load_shader_from_file(abs_path);
@@ -440,15 +1416,35 @@ static void load_output_effect(struct shader_filter_data *filter)
 	dstr_free(&filename);
 
 	obs_enter_graphics();
-	filter->output_effect = gs_effect_create(shader_text, NULL, &errors);
+	if (shader_text && gs_get_device_type() == GS_DEVICE_OPENGL) {
+		struct dstr effect_text = {0};
+		dstr_init_move_array(&effect_text, shader_text);
+		dstr_replace(&effect_text, "[loop]", "");
+		shader_text = effect_text.array;
+	}
+	gs_effect_t *effect = gs_effect_create(shader_text, NULL, &errors);
 	obs_leave_graphics();
 
 	bfree(shader_text);
-	if (filter->output_effect == NULL) {
-		blog(LOG_WARNING, "[obs-shaderfilter] Unable to load render_output.effect file.  Errors:\n%s",
+	if (effect == NULL) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to load %s file.  Errors:\n%s", effect_name,
 		     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
 		bfree(errors);
-	} else {
+	}
+	return effect;
+}
+
+static void load_output_effect(struct shader_filter_data *filter)
+{
+	if (filter->output_effect != NULL) {
+		obs_enter_graphics();
+		gs_effect_destroy(filter->output_effect);
+		filter->output_effect = NULL;
+		obs_leave_graphics();
+	}
+
+	filter->output_effect = load_internal_effect("render_output.effect");
+	if (filter->output_effect != NULL) {
 		size_t effect_count = gs_effect_get_num_params(filter->output_effect);
 		for (size_t effect_index = 0; effect_index < effect_count; effect_index++) {
 			gs_eparam_t *param = gs_effect_get_param_by_idx(filter->output_effect, effect_index);
@@ -461,113 +1457,209 @@ static void load_output_effect(struct shader_filter_data *filter)
 	}
 }
 
-static void load_sprite_buffer(struct shader_filter_data *filter)
+// image_stats.effect and the histogram point grid are loaded once and shared by every filter that uses image
+// statistics. Only touched with the graphics context held.
+static gs_effect_t *image_stats_effect = NULL;
+static gs_eparam_t *image_stats_param_image = NULL;
+static gs_eparam_t *image_stats_param_block_size = NULL;
+static gs_eparam_t *image_stats_param_texel_size = NULL;
+static gs_eparam_t *image_stats_param_block_texels = NULL;
+static gs_eparam_t *image_stats_param_histogram_weight = NULL;
+static gs_vertbuffer_t *image_stats_points = NULL;
+static long image_stats_users = 0;
+
+// One point per histogram sample, with the sample position in the texture coordinates.
+static gs_vertbuffer_t *image_stats_create_points(void)
 {
-	if (filter->sprite_buffer)
-		return;
+	const size_t count = IMAGE_STATS_HISTOGRAM_GRID * IMAGE_STATS_HISTOGRAM_GRID;
 	struct gs_vb_data *vbd = gs_vbdata_create();
-	vbd->num = 4;
-	vbd->points = bmalloc(sizeof(struct vec3) * 4);
+	vbd->num = count;
+	vbd->points = bzalloc(sizeof(struct vec3) * count);
 	vbd->num_tex = 1;
-	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray = bzalloc(sizeof(struct gs_tvertarray));
 	vbd->tvarray[0].width = 2;
-	vbd->tvarray[0].array = bmalloc(sizeof(struct vec2) * 4);
-	memset(vbd->points, 0, sizeof(struct vec3) * 4);
-	memset(vbd->tvarray[0].array, 0, sizeof(struct vec2) * 4);
-	filter->sprite_buffer = gs_vertexbuffer_create(vbd, GS_DYNAMIC);
+	vbd->tvarray[0].array = bmalloc(sizeof(struct vec2) * count);
+	struct vec2 *uv = vbd->tvarray[0].array;
+	for (size_t y = 0; y < IMAGE_STATS_HISTOGRAM_GRID; y++) {
+		for (size_t x = 0; x < IMAGE_STATS_HISTOGRAM_GRID; x++) {
+			vec2_set(uv++, ((float)x + 0.5f) / IMAGE_STATS_HISTOGRAM_GRID,
+				 ((float)y + 0.5f) / IMAGE_STATS_HISTOGRAM_GRID);
+		}
+	}
+	return gs_vertexbuffer_create(vbd, 0);
 }
 
-static void shader_filter_reload_effect(struct shader_filter_data *filter)
+// Graphics context held.
+static gs_effect_t *image_stats_acquire(void)
 {
-	obs_data_t *settings = obs_source_get_settings(filter->context);
-
-	// First, clean up the old effect and all references to it.
-	filter->shader_start_time = 0.0f;
-	shader_filter_clear_params(filter);
-
-	if (filter->effect != NULL) {
-		obs_enter_graphics();
-		gs_effect_destroy(filter->effect);
-		filter->effect = NULL;
-		obs_leave_graphics();
-	}
-
-	// Load text and build the effect from the template, if necessary.
-	char *shader_text = NULL;
-	bool use_template = !obs_data_get_bool(settings, "override_entire_effect");
-
-	if (obs_data_get_bool(settings, "from_file")) {
-		const char *file_name = obs_data_get_string(settings, "shader_file_name");
-		if (!strlen(file_name)) {
-			obs_data_unset_user_value(settings, "last_error");
-			goto end;
-		}
-		shader_text = load_shader_from_file(file_name);
-		if (!shader_text) {
-			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.FileLoadFailed"));
-			goto end;
-		}
-	} else {
-		shader_text = bstrdup(obs_data_get_string(settings, "shader_text"));
-		use_template = true;
+	if (!image_stats_users) {
+		image_stats_effect = load_internal_effect("image_stats.effect");
+		if (!image_stats_effect)
+			return NULL;
+		image_stats_param_image = gs_effect_get_param_by_name(image_stats_effect, "image");
+		image_stats_param_block_size = gs_effect_get_param_by_name(image_stats_effect, "block_size");
+		image_stats_param_texel_size = gs_effect_get_param_by_name(image_stats_effect, "texel_size");
+		image_stats_param_block_texels = gs_effect_get_param_by_name(image_stats_effect, "block_texels");
+		image_stats_param_histogram_weight = gs_effect_get_param_by_name(image_stats_effect, "histogram_weight");
+		image_stats_points = image_stats_create_points();
 	}
-	filter->use_template = use_template;
-
-	struct dstr effect_text = {0};
+	image_stats_users++;
+	return image_stats_effect;
+}
 
-	if (use_template) {
-		dstr_cat(&effect_text, effect_template_begin);
-	}
+// Graphics context held.
+static void image_stats_release(void)
+{
+	if (--image_stats_users)
+		return;
+	gs_effect_destroy(image_stats_effect);
+	gs_vertexbuffer_destroy(image_stats_points);
+	image_stats_effect = NULL;
+	image_stats_points = NULL;
+}
 
-	if (shader_text) {
-		dstr_cat(&effect_text, shader_text);
-		bfree(shader_text);
+static void free_image_stats(struct shader_filter_data *filter)
+{
+	obs_enter_graphics();
+	if (filter->stats_effect)
+		image_stats_release();
+	for (size_t i = 0; i < IMAGE_STATS_LEVELS; i++) {
+		if (filter->stats_levels[i])
+			gs_texrender_destroy(filter->stats_levels[i]);
+		filter->stats_levels[i] = NULL;
 	}
-
-	if (use_template) {
-		dstr_cat(&effect_text, effect_template_end);
+	if (filter->stats_histogram)
+		gs_texrender_destroy(filter->stats_histogram);
+	for (size_t i = 0; i < 2; i++) {
+		if (filter->stats_stagesurf[i])
+			gs_stagesurface_destroy(filter->stats_stagesurf[i]);
+		filter->stats_stagesurf[i] = NULL;
+		filter->stats_staged[i] = false;
 	}
+	obs_leave_graphics();
+	filter->stats_effect = NULL;
+	filter->stats_histogram = NULL;
+	filter->image_avg_luma = 0.0f;
+	vec2_zero(&filter->image_min_max);
+}
 
-	// Create the effect.
-	char *errors = NULL;
-
+static void load_image_stats(struct shader_filter_data *filter)
+{
+	if (filter->stats_effect)
+		return;
 	obs_enter_graphics();
-	int device_type = gs_get_device_type();
-	if (device_type == GS_DEVICE_OPENGL) {
-		dstr_replace(&effect_text, "[loop]", "");
-		dstr_insert(&effect_text, 0, "#define OPENGL 1\n");
-	}
+	filter->stats_effect = image_stats_acquire();
+	obs_leave_graphics();
+}
 
-	if (effect_text.len && dstr_find(&effect_text, "#define USE_PM_ALPHA 1")) {
-		filter->use_pm_alpha = true;
-	} else {
-		filter->use_pm_alpha = false;
-	}
+static void load_sprite_buffer(struct shader_filter_data *filter)
+{
+	if (filter->sprite_buffer)
+		return;
+	struct gs_vb_data *vbd = gs_vbdata_create();
+	vbd->num = 4;
+	vbd->points = bmalloc(sizeof(struct vec3) * 4);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bmalloc(sizeof(struct vec2) * 4);
+	memset(vbd->points, 0, sizeof(struct vec3) * 4);
+	memset(vbd->tvarray[0].array, 0, sizeof(struct vec2) * 4);
+	filter->sprite_buffer = gs_vertexbuffer_create(vbd, GS_DYNAMIC);
+}
 
-	if (filter->effect)
-		gs_effect_destroy(filter->effect);
-	filter->effect = gs_effect_create(effect_text.array, NULL, &errors);
-	obs_leave_graphics();
+// FNV-1a, used to identify shader text.
+static uint64_t hash_string(const char *text)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char *ch = text; ch && *ch; ch++)
+		hash = (hash ^ (uint8_t)*ch) * 1099511628211ULL;
+	return hash;
+}
 
-	if (filter->effect == NULL) {
-		blog(LOG_WARNING, "[obs-shaderfilter] Unable to create effect. Errors returned from parser:\n%s",
-		     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
-		if (errors && strlen(errors)) {
-			obs_data_set_string(settings, "last_error", errors);
-		} else {
-			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.Unknown"));
-		}
-		dstr_free(&effect_text);
-		bfree(errors);
-		goto end;
+// Points the built-in uniform called name at param, returns false when name is not a built-in.
+static bool shader_filter_bind_builtin_param(struct shader_filter_data *filter, const char *name, gs_eparam_t *param)
+{
+	if (strcmp(name, "uv_offset") == 0) {
+		filter->param_uv_offset = param;
+	} else if (strcmp(name, "uv_scale") == 0) {
+		filter->param_uv_scale = param;
+	} else if (strcmp(name, "uv_pixel_interval") == 0) {
+		filter->param_uv_pixel_interval = param;
+	} else if (strcmp(name, "uv_size") == 0) {
+		filter->param_uv_size = param;
+	} else if (strcmp(name, "current_time_ms") == 0) {
+		filter->param_current_time_ms = param;
+	} else if (strcmp(name, "current_time_sec") == 0) {
+		filter->param_current_time_sec = param;
+	} else if (strcmp(name, "current_time_min") == 0) {
+		filter->param_current_time_min = param;
+	} else if (strcmp(name, "current_time_hour") == 0) {
+		filter->param_current_time_hour = param;
+	} else if (strcmp(name, "current_time_day_of_week") == 0) {
+		filter->param_current_time_day_of_week = param;
+	} else if (strcmp(name, "current_time_day_of_month") == 0) {
+		filter->param_current_time_day_of_month = param;
+	} else if (strcmp(name, "current_time_month") == 0) {
+		filter->param_current_time_month = param;
+	} else if (strcmp(name, "current_time_day_of_year") == 0) {
+		filter->param_current_time_day_of_year = param;
+	} else if (strcmp(name, "current_time_year") == 0) {
+		filter->param_current_time_year = param;
+	} else if (strcmp(name, "elapsed_time") == 0) {
+		filter->param_elapsed_time = param;
+	} else if (strcmp(name, "elapsed_time_start") == 0) {
+		filter->param_elapsed_time_start = param;
+	} else if (strcmp(name, "elapsed_time_show") == 0) {
+		filter->param_elapsed_time_show = param;
+	} else if (strcmp(name, "elapsed_time_active") == 0) {
+		filter->param_elapsed_time_active = param;
+	} else if (strcmp(name, "elapsed_time_enable") == 0) {
+		filter->param_elapsed_time_enable = param;
+	} else if (strcmp(name, "rand_f") == 0) {
+		filter->param_rand_f = param;
+	} else if (strcmp(name, "rand_activation_f") == 0) {
+		filter->param_rand_activation_f = param;
+	} else if (strcmp(name, "rand_instance_f") == 0) {
+		filter->param_rand_instance_f = param;
+	} else if (strcmp(name, "loops") == 0) {
+		filter->param_loops = param;
+	} else if (strcmp(name, "loop_second") == 0) {
+		filter->param_loop_second = param;
+	} else if (strcmp(name, "local_time") == 0) {
+		filter->param_local_time = param;
+	} else if (strcmp(name, "audio_peak") == 0) {
+		filter->param_audio_peak = param;
+	} else if (strcmp(name, "audio_beat") == 0) {
+		filter->param_audio_beat = param;
+	} else if (strcmp(name, "audio_beat_phase") == 0) {
+		filter->param_audio_beat_phase = param;
+	} else if (strcmp(name, "audio_bpm") == 0) {
+		filter->param_audio_bpm = param;
+	} else if (strcmp(name, "audio_bass") == 0) {
+		filter->param_audio_bass = param;
+	} else if (strcmp(name, "audio_mid") == 0) {
+		filter->param_audio_mid = param;
+	} else if (strcmp(name, "audio_treble") == 0) {
+		filter->param_audio_treble = param;
+	} else if (strcmp(name, "audio_magnitude") == 0) {
+		filter->param_audio_magnitude = param;
+	} else if (strcmp(name, "audio_spectrum") == 0) {
+		filter->param_audio_spectrum = param;
+	} else if (strcmp(name, "image_avg_luma") == 0) {
+		filter->param_image_avg_luma = param;
+	} else if (strcmp(name, "image_min_max") == 0) {
+		filter->param_image_min_max = param;
+	} else if (strcmp(name, "image_histogram") == 0) {
+		filter->param_image_histogram = param;
 	} else {
-		dstr_free(&effect_text);
-		obs_data_unset_user_value(settings, "last_error");
+		return false;
 	}
+	return true;
+}
 
-	// Store references to the new effect's parameters.
-	da_free(filter->stored_param_list);
-
+static void shader_filter_load_effect_params(struct shader_filter_data *filter)
+{
 	size_t effect_count = gs_effect_get_num_params(filter->effect);
 	for (size_t effect_index = 0; effect_index < effect_count; effect_index++) {
 		gs_eparam_t *param = gs_effect_get_param_by_idx(filter->effect, effect_index);
@@ -576,58 +1668,8 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 		struct gs_effect_param_info info;
 		gs_effect_get_param_info(param, &info);
 
-		if (strcmp(info.name, "uv_offset") == 0) {
-			filter->param_uv_offset = param;
-		} else if (strcmp(info.name, "uv_scale") == 0) {
-			filter->param_uv_scale = param;
-		} else if (strcmp(info.name, "uv_pixel_interval") == 0) {
-			filter->param_uv_pixel_interval = param;
-		} else if (strcmp(info.name, "uv_size") == 0) {
-			filter->param_uv_size = param;
-		} else if (strcmp(info.name, "current_time_ms") == 0) {
-			filter->param_current_time_ms = param;
-		} else if (strcmp(info.name, "current_time_sec") == 0) {
-			filter->param_current_time_sec = param;
-		} else if (strcmp(info.name, "current_time_min") == 0) {
-			filter->param_current_time_min = param;
-		} else if (strcmp(info.name, "current_time_hour") == 0) {
-			filter->param_current_time_hour = param;
-		} else if (strcmp(info.name, "current_time_day_of_week") == 0) {
-			filter->param_current_time_day_of_week = param;
-		} else if (strcmp(info.name, "current_time_day_of_month") == 0) {
-			filter->param_current_time_day_of_month = param;
-		} else if (strcmp(info.name, "current_time_month") == 0) {
-			filter->param_current_time_month = param;
-		} else if (strcmp(info.name, "current_time_day_of_year") == 0) {
-			filter->param_current_time_day_of_year = param;
-		} else if (strcmp(info.name, "current_time_year") == 0) {
-			filter->param_current_time_year = param;
-		} else if (strcmp(info.name, "elapsed_time") == 0) {
-			filter->param_elapsed_time = param;
-		} else if (strcmp(info.name, "elapsed_time_start") == 0) {
-			filter->param_elapsed_time_start = param;
-		} else if (strcmp(info.name, "elapsed_time_show") == 0) {
-			filter->param_elapsed_time_show = param;
-		} else if (strcmp(info.name, "elapsed_time_active") == 0) {
-			filter->param_elapsed_time_active = param;
-		} else if (strcmp(info.name, "elapsed_time_enable") == 0) {
-			filter->param_elapsed_time_enable = param;
-		} else if (strcmp(info.name, "rand_f") == 0) {
-			filter->param_rand_f = param;
-		} else if (strcmp(info.name, "rand_activation_f") == 0) {
-			filter->param_rand_activation_f = param;
-		} else if (strcmp(info.name, "rand_instance_f") == 0) {
-			filter->param_rand_instance_f = param;
-		} else if (strcmp(info.name, "loops") == 0) {
-			filter->param_loops = param;
-		} else if (strcmp(info.name, "loop_second") == 0) {
-			filter->param_loop_second = param;
-		} else if (strcmp(info.name, "local_time") == 0) {
-			filter->param_local_time = param;
-		} else if (strcmp(info.name, "audio_peak") == 0) {
-			filter->param_audio_peak = param;
-		} else if (strcmp(info.name, "audio_magnitude") == 0) {
-			filter->param_audio_magnitude = param;
+		if (shader_filter_bind_builtin_param(filter, info.name, param)) {
+			// Nothing.
 		} else if (strcmp(info.name, "ViewProj") == 0) {
 			// Nothing.
 		} else if (strcmp(info.name, "image") == 0) {
@@ -636,6 +1678,27 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 			filter->param_previous_image = param;
 		} else if (strcmp(info.name, "previous_output") == 0) {
 			filter->param_previous_output = param;
+		} else if (strncmp(info.name, "image_history_", 14) == 0 && atoi(info.name + 14) >= 1 &&
+			   atoi(info.name + 14) <= IMAGE_HISTORY_MAX) {
+			// image_history_1 is the previous input, the highest index declared sets the history depth.
+			const int index = atoi(info.name + 14);
+			filter->param_image_history[index - 1] = param;
+			if (index > filter->history_depth)
+				filter->history_depth = index;
+			gs_eparam_t *downscale = gs_param_get_annotation_by_name(param, "downscale");
+			if (downscale) {
+				struct gs_effect_param_info downscale_info;
+				gs_effect_get_param_info(downscale, &downscale_info);
+				void *value = gs_effect_get_default_val(downscale);
+				int factor = 1;
+				if (value && downscale_info.type == GS_SHADER_PARAM_INT)
+					factor = *(int *)value;
+				else if (value && downscale_info.type == GS_SHADER_PARAM_FLOAT)
+					factor = (int)*(float *)value;
+				if (factor > filter->history_downscale)
+					filter->history_downscale = factor;
+				bfree(value);
+			}
 		} else if (filter->transition && strcmp(info.name, "image_a") == 0) {
 			filter->param_image_a = param;
 		} else if (filter->transition && strcmp(info.name, "image_b") == 0) {
@@ -703,1527 +1766,1988 @@ static void shader_filter_reload_effect(struct shader_filter_data *filter)
 			}
 		}
 	}
-
-end:
-	obs_data_release(settings);
 }
 
-static const char *shader_filter_get_name(void *unused)
+// Graphics context held. Device specific adjustments before gs_effect_create.
+static void prepare_effect_text(struct dstr *effect_text)
 {
-	UNUSED_PARAMETER(unused);
-	return obs_module_text("ShaderFilter");
+	if (gs_get_device_type() == GS_DEVICE_OPENGL) {
+		dstr_replace(effect_text, "[loop]", "");
+		dstr_insert(effect_text, 0, "#define OPENGL 1\n");
+	}
 }
 
-static void *shader_filter_create(obs_data_t *settings, obs_source_t *source)
+static void shader_filter_reload_effect(struct shader_filter_data *filter)
 {
-	struct shader_filter_data *filter = bzalloc(sizeof(struct shader_filter_data));
-	filter->context = source;
-	filter->reload_effect = true;
+	profile_start(reload_effect_name);
+	const uint64_t trace_start = trace_begin();
+	obs_data_t *settings = obs_source_get_settings(filter->context);
 
-	dstr_init(&filter->last_path);
-	dstr_copy(&filter->last_path, obs_data_get_string(settings, "shader_file_name"));
-	filter->last_from_file = obs_data_get_bool(settings, "from_file");
-	filter->rand_instance_f = (float)((double)rand_interval(0, 10000) / (double)10000);
-	filter->rand_activation_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+	// First, clean up the old effect and all references to it.
+	filter->shader_start_time = 0.0f;
+	filter->effect_generation++;
+	dstr_free(&filter->shader_body);
+	shader_filter_clear_params(filter);
 
-	da_init(filter->stored_param_list);
-	load_output_effect(filter);
-	obs_source_update(source, settings);
+	if (filter->effect != NULL) {
+		obs_enter_graphics();
+		gs_effect_destroy(filter->effect);
+		filter->effect = NULL;
+		obs_leave_graphics();
+	}
 
-	return filter;
-}
+	// Load text and build the effect from the template, if necessary.
+	char *shader_text = NULL;
+	bool use_template = !obs_data_get_bool(settings, "override_entire_effect");
 
-static void shader_filter_destroy(void *data)
-{
-	struct shader_filter_data *filter = data;
-	shader_filter_clear_params(filter);
+	dstr_free(&filter->shader_id);
+	if (obs_data_get_bool(settings, "from_file")) {
+		const char *file_name = obs_data_get_string(settings, "shader_file_name");
+		dstr_copy(&filter->shader_id, file_name);
+		if (!strlen(file_name)) {
+			obs_data_unset_user_value(settings, "last_error");
+			goto end;
+		}
+		profile_start(load_file_name);
+		shader_text = load_shader_from_file(file_name);
+		profile_end(load_file_name);
+		if (!shader_text) {
+			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.FileLoadFailed"));
+			goto end;
+		}
+	} else {
+		shader_text = bstrdup(obs_data_get_string(settings, "shader_text"));
+		use_template = true;
+		dstr_printf(&filter->shader_id, "text:%016llx", (unsigned long long)hash_string(shader_text));
+	}
+	filter->use_template = use_template;
+
+	struct dstr effect_text = {0};
+
+	if (use_template) {
+		dstr_cat(&effect_text, effect_template_begin);
+	}
+
+	if (shader_text) {
+		dstr_cat(&effect_text, shader_text);
+		if (use_template)
+			dstr_copy(&filter->shader_body, shader_text);
+		bfree(shader_text);
+	}
+
+	if (use_template) {
+		dstr_cat(&effect_text, effect_template_end);
+	}
+
+	// Create the effect.
+	char *errors = NULL;
 
 	obs_enter_graphics();
+	prepare_effect_text(&effect_text);
+
+	if (effect_text.len && dstr_find(&effect_text, "#define USE_PM_ALPHA 1")) {
+		filter->use_pm_alpha = true;
+	} else {
+		filter->use_pm_alpha = false;
+	}
+
 	if (filter->effect)
 		gs_effect_destroy(filter->effect);
-	if (filter->output_effect)
-		gs_effect_destroy(filter->output_effect);
-	if (filter->input_texrender)
-		gs_texrender_destroy(filter->input_texrender);
-	if (filter->output_texrender)
-		gs_texrender_destroy(filter->output_texrender);
-	if (filter->previous_input_texrender)
-		gs_texrender_destroy(filter->previous_input_texrender);
-	if (filter->previous_output_texrender)
-		gs_texrender_destroy(filter->previous_output_texrender);
-	if (filter->sprite_buffer)
-		gs_vertexbuffer_destroy(filter->sprite_buffer);
+	profile_start(create_effect_name);
+	const uint64_t compile_start = os_gettime_ns();
+	filter->effect = gs_effect_create(effect_text.array, NULL, &errors);
+	filter->compile_time_ns = os_gettime_ns() - compile_start;
+	if (trace_start) {
+		pthread_mutex_lock(&trace_mutex);
+		trace_push(create_effect_name, filter->trace_id, TRACE_THREAD_SETTINGS, compile_start, filter->compile_time_ns);
+		pthread_mutex_unlock(&trace_mutex);
+	}
+	profile_end(create_effect_name);
 	obs_leave_graphics();
 
-	dstr_free(&filter->last_path);
+	if (filter->effect == NULL) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to create effect. Errors returned from parser:\n%s",
+		     (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
+		if (errors && strlen(errors)) {
+			obs_data_set_string(settings, "last_error", errors);
+		} else {
+			obs_data_set_string(settings, "last_error", obs_module_text("ShaderFilter.Unknown"));
+		}
+		dstr_free(&effect_text);
+		bfree(errors);
+		goto end;
+	} else {
+		dstr_free(&effect_text);
+		obs_data_unset_user_value(settings, "last_error");
+	}
+
+	// Store references to the new effect's parameters.
+	profile_start(bind_params_name);
 	da_free(filter->stored_param_list);
+	shader_filter_load_effect_params(filter);
 
-	if (filter->volmeter)
-		obs_volmeter_destroy(filter->volmeter);
-	if (filter->audio_source_name)
-		bfree(filter->audio_source_name);
+	if (filter->param_image_avg_luma || filter->param_image_min_max || filter->param_image_histogram)
+		load_image_stats(filter);
+	else if (filter->stats_effect)
+		free_image_stats(filter);
+	profile_end(bind_params_name);
 
-	bfree(filter);
+end:
+	obs_data_release(settings);
+	trace_end(reload_effect_name, filter->trace_id, TRACE_THREAD_SETTINGS, trace_start);
+	profile_end(reload_effect_name);
 }
 
-static bool shader_filter_from_file_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+static const char *shader_filter_get_name(void *unused)
 {
-	UNUSED_PARAMETER(p);
-	struct shader_filter_data *filter = obs_properties_get_param(props);
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("ShaderFilter");
+}
 
-	bool from_file = obs_data_get_bool(settings, "from_file");
+// Deterministic mode: every instance advances by a fixed timestep, draws its random values from a PRNG seeded with
+// the module seed and its name, and sees a virtual clock and silent audio. Toggled module wide.
+#define DETERMINISTIC_EPOCH_MS 946684800000LL
 
-	obs_property_set_visible(obs_properties_get(props, "shader_text"), !from_file);
-	obs_property_set_visible(obs_properties_get(props, "shader_file_name"), from_file);
+static volatile bool deterministic = false;
+static volatile long deterministic_generation = 0;
+static uint32_t deterministic_fps = 60;
+static uint64_t deterministic_seed = 0;
 
-	if (from_file != filter->last_from_file) {
-		filter->reload_effect = true;
-	}
-	filter->last_from_file = from_file;
+// Recorded per tick. Files start with INPUT_STREAM_MAGIC, INPUT_STREAM_VERSION and sizeof(struct input_record) as
+// uint32 values, followed by the records in native byte order.
+#define INPUT_STREAM_MAGIC 0x43524653
+#define INPUT_STREAM_VERSION 1
 
-	return true;
+struct input_record {
+	int64_t clock_ms;
+	float seconds;
+	float rand_f;
+	float local_time;
+	float audio_peak;
+	float audio_magnitude;
+	float audio_bass;
+	float audio_mid;
+	float audio_treble;
+	float audio_beat;
+	float audio_beat_phase;
+	float audio_bpm;
+};
+
+static pthread_mutex_t input_stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t wall_clock_ms(void)
+{
+#ifdef _WIN32
+	FILETIME file_time;
+	GetSystemTimeAsFileTime(&file_time);
+	ULARGE_INTEGER t;
+	t.LowPart = file_time.dwLowDateTime;
+	t.HighPart = file_time.dwHighDateTime;
+	return (int64_t)((t.QuadPart - 116444736000000000ULL) / 10000);
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
 }
 
-static bool shader_filter_text_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+// splitmix64, so the sequence only depends on the seed.
+static float shader_filter_next_random(uint64_t *state)
 {
-	UNUSED_PARAMETER(p);
-	struct shader_filter_data *filter = obs_properties_get_param(props);
-	if (!filter)
-		return false;
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return (float)((double)(z >> 11) / (double)(1ULL << 53));
+}
 
-	const char *shader_text = obs_data_get_string(settings, "shader_text");
-	bool can_convert = strstr(shader_text, "void mainImage( out vec4") || strstr(shader_text, "void mainImage(out vec4") ||
-			   strstr(shader_text, "void main()") || strstr(shader_text, "vec4 effect(vec4");
-	obs_property_t *shader_convert = obs_properties_get(props, "shader_convert");
-	bool visible = obs_property_visible(obs_properties_get(props, "shader_text"));
-	if (obs_property_visible(shader_convert) != (can_convert && visible)) {
-		obs_property_set_visible(shader_convert, can_convert && visible);
-		return true;
-	}
-	return false;
-}
-
-static bool shader_filter_file_name_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+static float shader_filter_random(struct shader_filter_data *filter)
 {
-	struct shader_filter_data *filter = obs_properties_get_param(props);
-	const char *new_file_name = obs_data_get_string(settings, obs_property_name(p));
-
-	if ((dstr_is_empty(&filter->last_path) && strlen(new_file_name)) ||
-	    (filter->last_path.array && dstr_cmp(&filter->last_path, new_file_name) != 0)) {
-		filter->reload_effect = true;
-		dstr_copy(&filter->last_path, new_file_name);
-		size_t l = strlen(new_file_name);
-		if (l > 7 && strncmp(new_file_name + l - 7, ".effect", 7) == 0) {
-			obs_data_set_bool(settings, "override_entire_effect", true);
-		} else if (l > 7 && strncmp(new_file_name + l - 7, ".shader", 7) == 0) {
-			obs_data_set_bool(settings, "override_entire_effect", false);
-		}
-	}
-
-	return false;
+	if (deterministic)
+		return shader_filter_next_random(&filter->rng);
+	return (float)((double)rand_interval(0, 10000) / (double)10000);
 }
 
-static bool shader_filter_reload_effect_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+static void deterministic_reset(struct shader_filter_data *filter)
 {
-	UNUSED_PARAMETER(props);
-	UNUSED_PARAMETER(property);
-	struct shader_filter_data *filter = data;
-
-	filter->reload_effect = true;
-
-	obs_source_update(filter->context, NULL);
-
-	return false;
+	filter->rng = deterministic_seed ^ hash_string(obs_source_get_name(filter->context));
+	filter->deterministic_frame = 0;
+	filter->elapsed_time = 0.0f;
+	filter->elapsed_time_loop = 0.0f;
+	filter->loops = 0;
+	filter->shader_start_time = 0.0f;
+	filter->shader_enable_time = 0.0f;
+	filter->shader_show_time = 0.0f;
+	filter->shader_active_time = 0.0f;
+	filter->rand_instance_f = shader_filter_next_random(&filter->rng);
+	filter->rand_activation_f = shader_filter_next_random(&filter->rng);
+	filter->deterministic_generation = deterministic_generation;
 }
 
-static bool add_source_to_list(void *data, obs_source_t *source)
+static void deterministic_set(bool enabled, uint32_t fps, uint64_t seed)
 {
-	obs_property_t *p = data;
-	const char *name = obs_source_get_name(source);
-	size_t count = obs_property_list_item_count(p);
-	size_t idx = 0;
-	while (idx < count && strcmp(name, obs_property_list_item_string(p, idx)) > 0)
-		idx++;
-	obs_property_list_insert_string(p, idx, name, name);
-	return true;
+	deterministic_fps = fps ? fps : 60;
+	deterministic_seed = seed;
+	os_atomic_inc_long(&deterministic_generation);
+	deterministic = enabled;
+	blog(LOG_INFO, "[obs-shaderfilter] Deterministic mode %s (%u fps, seed %llu)", enabled ? "enabled" : "disabled",
+	     deterministic_fps, (unsigned long long)seed);
 }
 
-static bool is_var_char(char ch)
+// input_stream_mutex held.
+static bool input_stream_read(struct shader_filter_data *filter)
 {
-	return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+	if (fread(filter->replay_record, sizeof(struct input_record), 1, filter->replay_file) == 1)
+		return true;
+	// Loop the recording.
+	fseek(filter->replay_file, 3 * sizeof(uint32_t), SEEK_SET);
+	return fread(filter->replay_record, sizeof(struct input_record), 1, filter->replay_file) == 1;
 }
 
-static void convert_if_defined(struct dstr *effect_text)
+// Start of tick: returns the timestep to use and loads this frame's replayed inputs.
+static float input_stream_begin_tick(struct shader_filter_data *filter, float seconds)
 {
-	char *pos = strstr(effect_text->array, "#if defined(");
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = strstr(effect_text->array + diff + 12, ")\n");
-		pos = strstr(effect_text->array + diff + 12, "#if defined(");
-		if (ch && (!pos || ch < pos)) {
-			*ch = ' ';
-			dstr_remove(effect_text, diff, 12);
-			dstr_insert(effect_text, diff, "#ifdef ");
-			pos = strstr(effect_text->array + diff + 5, "#if defined(");
-		}
+	if (deterministic) {
+		if (filter->deterministic_generation != deterministic_generation)
+			deterministic_reset(filter);
+		seconds = 1.0f / (float)deterministic_fps;
 	}
+	if (!filter->input_stream_active)
+		return seconds;
+
+	pthread_mutex_lock(&input_stream_mutex);
+	if (filter->replay_file && input_stream_read(filter))
+		seconds = filter->replay_record->seconds;
+	pthread_mutex_unlock(&input_stream_mutex);
+	return seconds;
 }
 
-static void convert_atan(struct dstr *effect_text)
+// End of tick, after the live values are updated: applies deterministic or replayed values, records them.
+static void input_stream_end_tick(struct shader_filter_data *filter, float seconds)
 {
-	char *pos = strstr(effect_text->array, "atan(");
-	while (pos) {
-		if (is_var_char(*(pos - 1))) {
-			pos = strstr(pos + 5, "atan(");
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *comma = strstr(pos + 5, ",");
-		char *divide = strstr(pos + 5, "/");
-		if (!comma && !divide)
-			return;
-
-		int depth = 0;
-		char *open = strstr(pos + 5, "(");
-		char *close = strstr(pos + 5, ")");
-		if (!close)
-			return;
-		do {
-			while (open && open < close) {
-				depth++;
-				open = strstr(open + 1, "(");
-			}
-			while (depth > 0 && close && (!open || close < open)) {
-				depth--;
-				if (depth == 0 && (!comma || comma < close))
-					comma = strstr(close + 1, ",");
-				if (depth == 0 && (!divide || divide < close))
-					divide = strstr(close + 1, "/");
-				if (comma && open && comma > open && comma < close)
-					comma = NULL;
-				if (divide && open && divide > open && divide < close)
-					divide = NULL;
-
-				open = strstr(close + 1, "(");
-				close = strstr(close + 1, ")");
-			}
-		} while (depth > 0 && close);
-
-		if (close && comma && comma < close && (!open || comma < open)) {
-			//*comma = '/';
-			dstr_insert(effect_text, diff + 4, "2");
-		}
-		if (close && divide && divide < close && (!open || divide < open)) {
-			*divide = ',';
-			dstr_insert(effect_text, diff + 4, "2");
-		}
+	filter->clock_override = false;
+	if (deterministic) {
+		filter->deterministic_frame++;
+		filter->rand_f = shader_filter_next_random(&filter->rng);
+		filter->local_time = filter->elapsed_time;
+		filter->clock_ms = DETERMINISTIC_EPOCH_MS + (int64_t)(filter->deterministic_frame * 1000 / deterministic_fps);
+		filter->clock_override = true;
+		filter->audio_peak = 0.0f;
+		filter->audio_magnitude = 0.0f;
+		filter->audio_bass = 0.0f;
+		filter->audio_mid = 0.0f;
+		filter->audio_treble = 0.0f;
+		filter->audio_beat_value = 0.0f;
+		filter->audio_beat_phase = 0.0f;
+		filter->audio_bpm = 0.0f;
+	}
+	if (!filter->input_stream_active)
+		return;
 
-		pos = strstr(effect_text->array + diff + 5, "atan(");
+	pthread_mutex_lock(&input_stream_mutex);
+	if (filter->replay_file) {
+		const struct input_record *record = filter->replay_record;
+		filter->rand_f = record->rand_f;
+		filter->local_time = record->local_time;
+		filter->clock_ms = record->clock_ms;
+		filter->clock_override = true;
+		filter->audio_peak = record->audio_peak;
+		filter->audio_magnitude = record->audio_magnitude;
+		filter->audio_bass = record->audio_bass;
+		filter->audio_mid = record->audio_mid;
+		filter->audio_treble = record->audio_treble;
+		filter->audio_beat_value = record->audio_beat;
+		filter->audio_beat_phase = record->audio_beat_phase;
+		filter->audio_bpm = record->audio_bpm;
 	}
+	if (filter->record_file) {
+		struct input_record record = {
+			.clock_ms = filter->clock_override ? filter->clock_ms : wall_clock_ms(),
+			.seconds = seconds,
+			.rand_f = filter->rand_f,
+			.local_time = filter->local_time,
+			.audio_peak = filter->audio_peak,
+			.audio_magnitude = filter->audio_magnitude,
+			.audio_bass = filter->audio_bass,
+			.audio_mid = filter->audio_mid,
+			.audio_treble = filter->audio_treble,
+			.audio_beat = filter->audio_beat_value,
+			.audio_beat_phase = filter->audio_beat_phase,
+			.audio_bpm = filter->audio_bpm,
+		};
+		fwrite(&record, sizeof(record), 1, filter->record_file);
+	}
+	pthread_mutex_unlock(&input_stream_mutex);
 }
 
-static void insert_begin_of_block(struct dstr *effect_text, size_t diff, char *insert)
+// input_stream_mutex held.
+static void input_stream_close(struct shader_filter_data *filter, bool record)
 {
-	int depth = 0;
-	char *ch = effect_text->array + diff;
-	while (ch > effect_text->array && (*ch == ' ' || *ch == '\t'))
-		ch--;
-	while (ch > effect_text->array) {
-		while (*ch != '=' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' && *ch != '*' &&
-		       *ch != ' ' && *ch != '\t' && ch > effect_text->array)
-			ch--;
-		if (*ch == '(') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-				return;
-			}
-			ch--;
-			depth--;
-		} else if (*ch == ')') {
-			ch--;
-			depth++;
-		} else if (*ch == '=') {
-			dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-			return;
-		} else if (*ch == '+' || *ch == '-' || *ch == '/' || *ch == '*' || *ch == ' ' || *ch == '\t') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array + 1, insert);
-				return;
-			}
-			ch--;
-		}
+	FILE **file = record ? &filter->record_file : &filter->replay_file;
+	if (*file)
+		fclose(*file);
+	*file = NULL;
+	if (!record) {
+		bfree(filter->replay_record);
+		filter->replay_record = NULL;
 	}
+	filter->input_stream_active = filter->record_file || filter->replay_file;
 }
 
-static void insert_end_of_block(struct dstr *effect_text, size_t diff, char *insert)
+// Starts recording to or replaying from path, or stops when path is empty. Returns false if the file is unusable.
+static bool input_stream_open(struct shader_filter_data *filter, const char *path, bool record)
 {
-	int depth = 0;
-	char *ch = effect_text->array + diff;
-	while (*ch == ' ' || *ch == '\t')
-		ch++;
-	while (*ch != 0) {
-		while (*ch != ';' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' && *ch != '*' &&
-		       *ch != ' ' && *ch != '\t' && *ch != ',' && *ch != 0)
-			ch++;
-		if (*ch == '(') {
-			ch++;
-			depth++;
-		} else if (*ch == ')') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array, insert);
-				return;
-			}
-			ch++;
-			depth--;
-		} else if (*ch == ';') {
-			dstr_insert(effect_text, ch - effect_text->array, insert);
-			return;
-		} else if (*ch == '+' || *ch == '-' || *ch == '/' || *ch == '*' || *ch == ' ' || *ch == '\t' || *ch == ',') {
-			if (depth == 0) {
-				dstr_insert(effect_text, ch - effect_text->array, insert);
-				return;
+	uint32_t header[3] = {INPUT_STREAM_MAGIC, INPUT_STREAM_VERSION, sizeof(struct input_record)};
+	bool success = true;
+
+	pthread_mutex_lock(&input_stream_mutex);
+	input_stream_close(filter, record);
+	if (path && *path) {
+		FILE *file = os_fopen(path, record ? "wb" : "rb");
+		if (file && record) {
+			success = fwrite(header, sizeof(header), 1, file) == 1;
+		} else if (file) {
+			uint32_t read[3];
+			success = fread(read, sizeof(read), 1, file) == 1 && memcmp(read, header, sizeof(header)) == 0;
+		} else {
+			success = false;
+		}
+		if (success) {
+			if (record) {
+				filter->record_file = file;
+			} else {
+				filter->replay_file = file;
+				filter->replay_record = bzalloc(sizeof(struct input_record));
 			}
-			ch++;
+			filter->input_stream_active = true;
+		} else if (file) {
+			fclose(file);
 		}
 	}
+	pthread_mutex_unlock(&input_stream_mutex);
+
+	if (!success)
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to %s input stream '%s' for '%s'", record ? "record" : "replay",
+		     path, obs_source_get_name(filter->context));
+	return success;
 }
 
-static void convert_mat_mul_var(struct dstr *effect_text, struct dstr *var_function_name)
+#define CPU_STATS_WINDOW 60
+
+// Returns the number of allocations made so far on the calling thread. libobs only counts the allocations of the
+// whole process, so this comes from a host that installed its own counting allocator, see
+// shader_filter_set_alloc_counter. Set once before any filter is created, NULL when allocations are not counted.
+static long long (*alloc_counter)(void) = NULL;
+
+struct cpu_sample {
+	uint64_t start;
+	long long allocs;
+};
+
+static inline struct cpu_sample cpu_sample_begin(void)
 {
-	char *pos = strstr(effect_text->array, var_function_name->array);
-	while (pos) {
-		if (is_var_char(*(pos - 1)) || is_var_char(*(pos + var_function_name->len))) {
-			pos = strstr(pos + var_function_name->len, var_function_name->array);
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_function_name->len;
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
-		if (*ch == '*' && *(ch + 1) != '=') {
-			size_t diff3 = ch - effect_text->array + 1;
-			*ch = ',';
-			insert_end_of_block(effect_text, diff3, ")");
-			dstr_insert(effect_text, diff, "mul(");
-			pos = strstr(effect_text->array + diff + 4 + var_function_name->len, var_function_name->array);
-			continue;
-		}
-		ch = pos - 1;
-		while ((*ch == ' ' || *ch == '\t') && ch > effect_text->array)
-			ch--;
-		if (*ch == '=' && *(ch - 1) == '*') {
-			char *end = ch - 2;
-			while ((*end == ' ' || *end == '\t') && end > effect_text->array)
-				end--;
-			char *start = end;
-			while ((is_var_char(*start) || *start == '.') && start > effect_text->array)
-				start--;
-			start++;
-			end++;
-
-			diff = ch - 1 - effect_text->array;
-
-			struct dstr insert = {0};
-			dstr_init_copy(&insert, "= mul(");
-			dstr_ncat(&insert, start, end - start);
-			dstr_cat(&insert, ",");
-			dstr_remove(effect_text, diff, 2);
-			dstr_insert(effect_text, diff, insert.array);
-
-			char *line_end = effect_text->array + diff;
-			while (*line_end != ';' && *line_end != 0)
-				line_end++;
-
-			dstr_insert(effect_text, line_end - effect_text->array, ")");
-
-			pos = strstr(effect_text->array + diff + insert.len + 1 + var_function_name->len, var_function_name->array);
-			dstr_free(&insert);
+	struct cpu_sample sample = {os_gettime_ns(), alloc_counter ? alloc_counter() : 0};
+	return sample;
+}
 
-			continue;
-		} else if (*ch == '*') {
-			size_t diff2 = ch - effect_text->array - 1;
-			*ch = ',';
-			insert_end_of_block(effect_text, diff + var_function_name->len, ")");
-			insert_begin_of_block(effect_text, diff2, "mul(");
+static void cpu_sample_end(struct shader_filter_data *filter, struct cpu_sample sample)
+{
+	filter->cpu_window_ns += os_gettime_ns() - sample.start;
+	if (alloc_counter)
+		filter->cpu_window_allocs += alloc_counter() - sample.allocs;
+}
 
-			pos = strstr(effect_text->array + diff + 4 + var_function_name->len, var_function_name->array);
-			continue;
-		}
+// Once per tick, after the tick itself was sampled.
+static void cpu_stats_frame(struct shader_filter_data *filter)
+{
+	if (++filter->cpu_window_frames < CPU_STATS_WINDOW)
+		return;
+	filter->cpu_time_ns += filter->cpu_window_ns;
+	filter->cpu_allocs += filter->cpu_window_allocs;
+	filter->cpu_frames += filter->cpu_window_frames;
+	filter->cpu_us_per_frame = (double)filter->cpu_window_ns / 1000.0 / filter->cpu_window_frames;
+	filter->allocs_per_frame = (double)filter->cpu_window_allocs / filter->cpu_window_frames;
+	filter->cpu_window_ns = 0;
+	filter->cpu_window_allocs = 0;
+	filter->cpu_window_frames = 0;
+}
 
-		pos = strstr(effect_text->array + diff + var_function_name->len, var_function_name->array);
-	}
+// Every live filter and transition, for the shader_filter_get_stats proc handler.
+static pthread_mutex_t filter_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t filter_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct shader_filter_data *) filter_registry;
+
+static void filter_registry_add(struct shader_filter_data *filter)
+{
+	pthread_mutex_lock(&filter_registry_mutex);
+	da_push_back(filter_registry, &filter);
+	pthread_mutex_unlock(&filter_registry_mutex);
 }
 
-static void convert_mat_mul(struct dstr *effect_text, char *var_type)
+static void filter_registry_remove(struct shader_filter_data *filter)
 {
-	size_t len = strlen(var_type);
-	char *pos = strstr(effect_text->array, var_type);
-	while (pos) {
-		if (is_var_char(*(pos - 1))) {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		size_t diff = pos - effect_text->array;
-		char *begin = pos + len;
-		if (*begin == '(') {
-			char *ch = pos - 1;
-			while ((*ch == ' ' || *ch == '\t') && ch > effect_text->array)
-				ch--;
-			if (*ch == '=' && *(ch - 1) == '*') {
-				// mat constructor with *= in front of it
-				char *end = ch - 2;
-				while ((*end == ' ' || *end == '\t') && end > effect_text->array)
-					end--;
-				char *start = end;
-				while ((is_var_char(*start) || *start == '.') && start > effect_text->array)
-					start--;
-				start++;
-				end++;
-
-				size_t diff2 = ch - effect_text->array - 1;
-
-				struct dstr insert = {0};
-				dstr_init_copy(&insert, "= mul(");
-				dstr_ncat(&insert, start, end - start);
-				dstr_cat(&insert, ",");
-				dstr_remove(effect_text, diff2, 2);
-				dstr_insert(effect_text, diff2, insert.array);
-
-				char *line_end = effect_text->array + diff2;
-				while (*line_end != ';' && *line_end != 0)
-					line_end++;
-
-				dstr_insert(effect_text, line_end - effect_text->array, ")");
-
-				pos = strstr(effect_text->array + diff + insert.len + len + 1, var_type);
-				dstr_free(&insert);
+	pthread_mutex_lock(&filter_registry_mutex);
+	da_erase_item(filter_registry, &filter);
+	pthread_mutex_unlock(&filter_registry_mutex);
+}
 
-				continue;
-			} else if (*ch == '*') {
-				// mat constructor with * in front of it
-				size_t diff2 = ch - effect_text->array - 1;
-				*ch = ',';
-				insert_end_of_block(effect_text, diff + len, ")");
-				insert_begin_of_block(effect_text, diff2, "mul(");
-
-				pos = strstr(effect_text->array + diff + len + 4, var_type);
-				continue;
-			}
+struct trace_instance {
+	long id;
+	char *name;
+};
 
-			int depth = 1;
-			ch = begin + 1;
-			while (*ch != 0) {
-				while (*ch != ';' && *ch != '(' && *ch != ')' && *ch != '+' && *ch != '-' && *ch != '/' &&
-				       *ch != '*' && *ch != 0)
-					ch++;
-				if (*ch == '(') {
-					ch++;
-					depth++;
-				} else if (*ch == ')') {
-					if (depth == 0) {
-						break;
-					}
-					ch++;
-					depth--;
-				} else if (*ch == '*') {
-					if (depth == 0) {
-						//mat constructor follow by *
-						*ch = ',';
-						insert_end_of_block(effect_text, ch - effect_text->array + 1, ")");
-						dstr_insert(effect_text, diff, "mul(");
-						break;
-					}
-					ch++;
-				} else if (*ch == ';') {
-					break;
-				} else if (depth == 0) {
-					break;
-				} else if (*ch != 0) {
-					ch++;
-				}
-			}
-		}
-		if (*begin != ' ' && *begin != '\t') {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		while (*begin == ' ' || *begin == '\t')
-			begin++;
-		if (!is_var_char(*begin)) {
-			pos = strstr(pos + len, var_type);
-			continue;
-		}
-		char *end = begin;
-		while (is_var_char(*end))
-			end++;
-		struct dstr var_function_name = {0};
-		dstr_ncat(&var_function_name, begin, end - begin);
+struct trace_snapshot {
+	struct trace_event *events;
+	size_t count;
+	DARRAY(struct trace_instance) instances;
+	char *path;
+};
 
-		convert_mat_mul_var(effect_text, &var_function_name);
-		dstr_free(&var_function_name);
+static volatile long output_file_count = 0;
+static volatile long trace_dumps_running = 0;
 
-		pos = strstr(effect_text->array + diff + len, var_type);
-	}
+// Unique <folder>/<prefix>_<date>_<n>.json in the plugin config directory.
+static char *make_output_path(const char *folder, const char *prefix)
+{
+	char *dir = obs_module_config_path(folder);
+	if (!dir)
+		return NULL;
+	os_mkdirs(dir);
+
+	char stamp[32];
+	const time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+
+	struct dstr path = {0};
+	dstr_printf(&path, "%s/%s_%s_%ld.json", dir, prefix, stamp, os_atomic_inc_long(&output_file_count));
+	bfree(dir);
+	return path.array;
 }
 
-static bool is_in_function(struct dstr *effect_text, size_t diff)
+// Returns NULL when nothing has been recorded.
+static struct trace_snapshot *trace_snapshot_create(void)
 {
-	char *pos = effect_text->array + diff;
-	int depth = 0;
-	while (depth >= 0) {
-		char *end = strstr(pos, "}");
-		char *begin = strstr(pos, "{");
-		if (end && begin && begin < end) {
-			pos = begin + 1;
-			depth++;
-		} else if (end && begin && end < begin) {
-			pos = end + 1;
-			depth--;
-		} else if (end) {
-			pos = end + 1;
-			depth--;
-		} else if (begin && depth < 0) {
-			break;
-		} else if (begin) {
-			pos = begin + 1;
-			depth++;
-		} else {
-			break;
-		}
+	struct trace_snapshot *snapshot = NULL;
+	pthread_mutex_lock(&trace_mutex);
+	if (trace_events && trace_count) {
+		snapshot = bzalloc(sizeof(struct trace_snapshot));
+		snapshot->count = trace_count < TRACE_RING ? trace_count : TRACE_RING;
+		snapshot->events = bmalloc(sizeof(struct trace_event) * snapshot->count);
+		// Oldest first.
+		for (size_t i = 0; i < snapshot->count; i++)
+			snapshot->events[i] = trace_events[(trace_count - snapshot->count + i) % TRACE_RING];
 	}
-	return depth != 0;
+	pthread_mutex_unlock(&trace_mutex);
+	if (!snapshot)
+		return NULL;
+
+	pthread_mutex_lock(&filter_registry_mutex);
+	for (size_t i = 0; i < filter_registry.num; i++) {
+		struct trace_instance *instance = da_push_back_new(snapshot->instances);
+		instance->id = filter_registry.array[i]->trace_id;
+		instance->name = bstrdup(obs_source_get_name(filter_registry.array[i]->context));
+	}
+	pthread_mutex_unlock(&filter_registry_mutex);
+	snapshot->path = make_output_path("traces", "trace");
+	return snapshot;
 }
 
-static void convert_init(struct dstr *effect_text, char *name)
+static void trace_snapshot_destroy(struct trace_snapshot *snapshot)
 {
-	const size_t len = strlen(name);
-	char extra = 0;
-	char *pos = strstr(effect_text->array, name);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		if (pos > effect_text->array && is_var_char(*(pos - 1))) {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		char *ch = pos + len;
-		if (*ch >= '2' && *ch <= '9') {
-			extra = *ch;
-			ch++;
-		} else {
-			extra = 0;
-		}
-		if (*ch != ' ' && *ch != '\t') {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		char *begin = pos - 1;
-		while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-			begin--;
-		if (*begin == '(' || *begin == ',' ||
-		    (is_var_char(*begin) && memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0)) {
-			pos = strstr(effect_text->array + diff + len, name);
-			continue;
-		}
-		if (!is_in_function(effect_text, diff)) {
-			while (true) {
-				while (*ch != 0 && (*ch == ' ' || *ch == '\t'))
-					ch++;
-				while (is_var_char(*ch))
-					ch++;
-				while (*ch != 0 && (*ch == ' ' || *ch == '\t'))
-					ch++;
-				if (*ch != ',')
-					break;
-				*ch = ';';
-				diff = ch - effect_text->array;
-				dstr_insert(effect_text, diff + 1, " ");
-				if (extra) {
-					dstr_insert_ch(effect_text, diff + 1, extra);
-				}
-				dstr_insert(effect_text, diff + 1, name);
-				if (memcmp("const", begin - 4, 5) == 0) {
-					dstr_insert(effect_text, diff + 1, "\nconst ");
-					diff += 9;
-				} else {
-					dstr_insert(effect_text, diff + 1, "\nuniform ");
-					diff += 11;
-				}
-				if (extra)
-					diff++;
-				ch = effect_text->array + diff + len;
-			}
+	for (size_t i = 0; i < snapshot->instances.num; i++)
+		bfree(snapshot->instances.array[i].name);
+	da_free(snapshot->instances);
+	bfree(snapshot->events);
+	bfree(snapshot->path);
+	bfree(snapshot);
+}
 
-			if ((*ch == '=' && *(ch + 1) != '=') || *ch == ';') {
-				if (memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0) {
-					dstr_insert(effect_text, begin - effect_text->array + 1, "uniform ");
-					diff += 8;
-				}
-			}
-		}
-		pos = strstr(effect_text->array + diff + len, name);
+static void trace_write_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; str && *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(file, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(file, "\\u%04x", (unsigned char)*str);
+		else
+			fputc(*str, file);
 	}
+	fputc('"', file);
 }
 
-static void convert_vector_init(struct dstr *effect_text, char *name, int count)
+static void trace_write_metadata(FILE *file, const char *type, long pid, int tid, const char *name)
 {
-	const size_t len = strlen(name);
+	fprintf(file, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%d,\"args\":{\"name\":", type, pid, tid);
+	trace_write_string(file, name);
+	fprintf(file, "}},\n");
+}
 
-	char *pos = strstr(effect_text->array, name);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + len;
-		int depth = 0;
-		int function_depth = -1;
-		bool only_one = true;
-		bool only_numbers = true;
-		bool only_float = true;
-		while (*ch != 0 && (only_numbers || only_float)) {
-			if (*ch == '(') {
-				depth++;
-			} else if (*ch == ')') {
-				if (depth == 0) {
-					break;
-				}
-				depth--;
-				if (depth == function_depth) {
-					function_depth = -1;
-				}
-			} else if (*ch == ',') {
-				if (depth == 0) {
-					only_one = false;
-				}
-			} else if (*ch == ';') {
-				only_one = false;
-				break;
-			} else if (is_var_char(*ch) && (*ch < '0' || *ch > '9')) {
-				only_numbers = false;
-				char *begin = ch;
-				while (is_var_char(*ch))
-					ch++;
-				if (*ch == '.') {
-					size_t c = 1;
-					while (is_var_char(*(ch + c)))
-						c++;
-					if (c != 2 && function_depth < 0)
-						only_float = false;
-					ch += c - 1;
-				} else if (function_depth >= 0) {
-					ch--;
-				} else if (*ch == '(' &&
-					   (strncmp(begin, "length(", 7) == 0 || strncmp(begin, "float(", 6) == 0 ||
-					    strncmp(begin, "uint(", 5) == 0 || strncmp(begin, "int(", 4) == 0 ||
-					    strncmp(begin, "asfloat(", 8) == 0 || strncmp(begin, "asdouble(", 9) == 0 ||
-					    strncmp(begin, "asint(", 6) == 0 || strncmp(begin, "asuint(", 7) == 0 ||
-					    strncmp(begin, "determinant(", 12) == 0 || strncmp(begin, "distance(", 9) == 0 ||
-					    strncmp(begin, "dot(", 4) == 0 || strncmp(begin, "countbits(", 10) == 0 ||
-					    strncmp(begin, "firstbithigh(", 13) == 0 || strncmp(begin, "firstbitlow(", 12) == 0 ||
-					    strncmp(begin, "reversebits(", 12) == 0)) {
-					function_depth = depth;
-					depth++;
-				} else if (*ch == '(' &&
-					   (strncmp(begin, "abs(", 4) == 0 || strncmp(begin, "acos(", 5) == 0 ||
-					    strncmp(begin, "asin(", 5) == 0 || strncmp(begin, "atan(", 5) == 0 ||
-					    strncmp(begin, "atan2(", 6) == 0 || strncmp(begin, "ceil(", 5) == 0 ||
-					    strncmp(begin, "clamp(", 6) == 0 || strncmp(begin, "cos(", 4) == 0 ||
-					    strncmp(begin, "cosh(", 5) == 0 || strncmp(begin, "ddx(", 4) == 0 ||
-					    strncmp(begin, "ddy(", 4) == 0 || strncmp(begin, "degrees(", 8) == 0 ||
-					    strncmp(begin, "exp(", 4) == 0 || strncmp(begin, "exp2(", 5) == 0 ||
-					    strncmp(begin, "floor(", 6) == 0 || strncmp(begin, "fma(", 4) == 0 ||
-					    strncmp(begin, "fmod(", 5) == 0 || strncmp(begin, "frac(", 5) == 0 ||
-					    strncmp(begin, "frexp(", 6) == 0 || strncmp(begin, "fwidth(", 7) == 0 ||
-					    strncmp(begin, "ldexp(", 6) == 0 || strncmp(begin, "lerp(", 5) == 0 ||
-					    strncmp(begin, "log(", 4) == 0 || strncmp(begin, "log10(", 6) == 0 ||
-					    strncmp(begin, "log2(", 5) == 0 || strncmp(begin, "mad(", 4) == 0 ||
-					    strncmp(begin, "max(", 4) == 0 || strncmp(begin, "min(", 4) == 0 ||
-					    strncmp(begin, "modf(", 5) == 0 || strncmp(begin, "mod(", 4) == 0 ||
-					    strncmp(begin, "mul(", 4) == 0 || strncmp(begin, "normalize(", 10) == 0 ||
-					    strncmp(begin, "pow(", 4) == 0 || strncmp(begin, "radians(", 8) == 0 ||
-					    strncmp(begin, "rcp(", 4) == 0 || strncmp(begin, "reflect(", 8) == 0 ||
-					    strncmp(begin, "refract(", 8) == 0 || strncmp(begin, "round(", 6) == 0 ||
-					    strncmp(begin, "rsqrt(", 6) == 0 || strncmp(begin, "saturate(", 9) == 0 ||
-					    strncmp(begin, "sign(", 5) == 0 || strncmp(begin, "sin(", 4) == 0 ||
-					    strncmp(begin, "sincos(", 7) == 0 || strncmp(begin, "sinh(", 5) == 0 ||
-					    strncmp(begin, "smoothstep(", 11) == 0 || strncmp(begin, "sqrt(", 5) == 0 ||
-					    strncmp(begin, "step(", 5) == 0 || strncmp(begin, "tan(", 4) == 0 ||
-					    strncmp(begin, "tanh(", 5) == 0 || strncmp(begin, "transpose(", 10) == 0 ||
-					    strncmp(begin, "trunc(", 6) == 0)) {
-					depth++;
-				} else {
-					struct dstr find = {0};
-					bool found = false;
-					dstr_copy(&find, "float ");
-					dstr_ncat(&find, begin, ch - begin + (*ch == '(' ? 1 : 0));
-					char *t = strstr(effect_text->array, find.array);
-					while (t != NULL) {
-						t += find.len;
-						if (*ch == '(') {
-							found = true;
-							break;
-						} else if (!is_var_char(*t)) {
-							found = true;
-							break;
-						}
-						t = strstr(t, find.array);
-					}
-					if (!found) {
-						dstr_copy(&find, "int ");
-						dstr_ncat(&find, begin, ch - begin + (*ch == '(' ? 1 : 0));
-						t = strstr(effect_text->array, find.array);
-						while (t != NULL) {
-							t += find.len;
-							if (*ch == '(') {
-								found = true;
-								break;
-							} else if (!is_var_char(*t)) {
-								found = true;
-								break;
-							}
-							t = strstr(t, find.array);
-						}
-					}
-					if (!found && *ch != '(') {
-						dstr_copy(&find, "#define ");
-						dstr_ncat(&find, begin, ch - begin);
-						char *t = strstr(effect_text->array, find.array);
-						while (t != NULL) {
-							t += find.len;
-							if (!is_var_char(*t)) {
-								while (*t == ' ' || *t == '\t')
-									t++;
-								if (*t >= '0' && *t <= '9') {
-									found = true;
-									break;
-								}
-							}
-							t = strstr(t, find.array);
-						}
-					}
-					if (!found) {
-						only_float = false;
-					} else if (*ch == '(') {
-						function_depth = depth;
-					}
-					dstr_free(&find);
-					ch--;
-				}
-			} else if ((*ch < '0' || *ch > '9') && *ch != '.' && *ch != ' ' && *ch != '\t' && *ch != '+' &&
-				   *ch != '-' && *ch != '*' && *ch != '/') {
-				only_numbers = false;
-			}
-			ch++;
-		}
-		size_t end_diff = ch - effect_text->array;
-		if (count > 1 && only_one && (only_numbers || only_float)) {
-			//only 1 simple arg in the float4
-			struct dstr found = {0};
-			dstr_init(&found);
-			dstr_ncat(&found, pos, ch - pos + 1);
-
-			struct dstr replacement = {0};
-			dstr_init_copy(&replacement, name);
-			dstr_ncat(&replacement, pos + len, ch - (pos + len));
-			for (int i = 1; i < count; i++) {
-				dstr_cat(&replacement, ",");
-				dstr_ncat(&replacement, pos + len, ch - (pos + len));
-			}
-			dstr_cat(&replacement, ")");
-
-			dstr_replace(effect_text, found.array, replacement.array);
-
-			end_diff -= found.len;
-			end_diff += replacement.len;
-			dstr_free(&replacement);
-			dstr_free(&found);
-		}
-
-		if (!is_in_function(effect_text, diff)) {
-			char *begin = effect_text->array + diff - 1;
-			while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-				begin--;
-			if (*begin == '=') {
-				begin--;
-				while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-					begin--;
-				while (is_var_char(*begin))
-					begin--;
-				while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-					begin--;
-				if (memcmp(name, begin - len + 2, len - 1) == 0) {
-
-					begin -= len - 1;
-					while (begin > effect_text->array && (*begin == ' ' || *begin == '\t'))
-						begin--;
-					if (memcmp("uniform", begin - 6, 7) != 0 && memcmp("const", begin - 4, 5) != 0) {
-						dstr_insert(effect_text, begin - effect_text->array + 1, "uniform ");
-						diff += 8;
-						end_diff += 8;
-					}
-					if (effect_text->array[end_diff] == ')') {
-						if (count > 1) {
-							effect_text->array[end_diff] = '}';
-							dstr_remove(effect_text, diff, len);
-							dstr_insert(effect_text, diff, "{");
-						} else {
-							dstr_remove(effect_text, end_diff, 1);
-							dstr_remove(effect_text, diff, len);
-						}
-					}
-				}
-			}
-		}
+// Chrome trace_event format: every instance is a process, its graphics, audio and settings work are threads.
+static bool trace_snapshot_write(struct trace_snapshot *snapshot)
+{
+	FILE *file = snapshot->path ? os_fopen(snapshot->path, "wb") : NULL;
+	if (!file) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to write trace file %s", snapshot->path ? snapshot->path : "");
+		return false;
+	}
 
-		pos = strstr(effect_text->array + diff + len, name);
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	trace_write_metadata(file, "process_name", 0, 0, "obs-shaderfilter");
+	for (size_t i = 0; i < snapshot->instances.num; i++) {
+		const struct trace_instance *instance = snapshot->instances.array + i;
+		trace_write_metadata(file, "process_name", instance->id, 0, instance->name);
+		for (int t = 0; t < TRACE_THREAD_COUNT; t++)
+			trace_write_metadata(file, "thread_name", instance->id, t, trace_thread_names[t]);
 	}
+	for (size_t i = 0; i < snapshot->count; i++) {
+		const struct trace_event *event = snapshot->events + i;
+		fprintf(file,
+			"%s{\"name\":\"%s\",\"cat\":\"shaderfilter\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%d}",
+			i ? ",\n" : "", event->name, (double)event->start / 1000.0, (double)event->duration / 1000.0,
+			event->instance, (int)event->thread);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	blog(LOG_INFO, "[obs-shaderfilter] Wrote %zu trace events to %s", snapshot->count, snapshot->path);
+	return true;
 }
 
-static void convert_if0(struct dstr *effect_text)
+static void *trace_dump_thread(void *data)
 {
-	char *begin = strstr(effect_text->array, "#if 0");
-	while (begin) {
-		size_t diff = begin - effect_text->array;
-		char *end = strstr(begin, "#endif");
-		if (!end)
-			return;
-		char *el = strstr(begin, "#else");
-		char *eli = strstr(begin, "#elif");
-		if (eli && eli < end && (!el || eli < el)) {
-			//replace #elif with #if
-			dstr_remove(effect_text, diff, el - begin + 5);
-			dstr_insert(effect_text, diff, "#if");
-			begin = strstr(effect_text->array + diff + 3, "#if 0");
-		} else if (el && el < end) {
-			dstr_remove(effect_text, end - effect_text->array,
-				    6); // #endif
-			dstr_remove(effect_text, diff, el - begin + 5);
-			begin = strstr(effect_text->array + diff, "#if 0");
-		} else if (!el || el > end) {
-			dstr_remove(effect_text, diff, end - begin + 6);
-			begin = strstr(effect_text->array + diff, "#if 0");
-		} else {
-			begin = strstr(effect_text->array + diff + 5, "#if 0");
-		}
+	struct trace_snapshot *snapshot = data;
+	os_set_thread_name("shaderfilter: trace dump");
+	trace_snapshot_write(snapshot);
+	trace_snapshot_destroy(snapshot);
+	os_atomic_dec_long(&trace_dumps_running);
+	return NULL;
+}
+
+// Writing the file would cause another slow frame on the graphics thread, so it happens on its own thread.
+static void trace_dump_async(void)
+{
+	struct trace_snapshot *snapshot = trace_snapshot_create();
+	if (!snapshot)
+		return;
+	pthread_t thread;
+	os_atomic_inc_long(&trace_dumps_running);
+	if (pthread_create(&thread, NULL, trace_dump_thread, snapshot) == 0) {
+		pthread_detach(thread);
+	} else {
+		os_atomic_dec_long(&trace_dumps_running);
+		trace_snapshot_destroy(snapshot);
 	}
 }
 
-static void convert_if1(struct dstr *effect_text)
+// Called from every tick; the first tick of a video frame closes the previous frame's event.
+static void trace_frame(void)
 {
-	char *begin = strstr(effect_text->array, "#if 1");
-	while (begin) {
-		size_t diff = begin - effect_text->array;
-		char *end = strstr(begin, "#endif");
-		if (!end)
-			return;
-		char *el = strstr(begin, "#el");
-		if (el && el < end) {
-			dstr_remove(effect_text, el - effect_text->array,
-				    end - el + 6); // #endif
-			end = strstr(effect_text->array + diff, "\n");
-			if (end)
-				dstr_remove(effect_text, diff, end - (effect_text->array + diff));
-			begin = strstr(effect_text->array + diff, "#if 1");
-		} else if (!el || el > end) {
-			dstr_remove(effect_text, end - effect_text->array, 6);
-			end = strstr(effect_text->array + diff, "\n");
-			if (end)
-				dstr_remove(effect_text, diff, end - (effect_text->array + diff));
-			begin = strstr(effect_text->array + diff, "#if 1");
-		} else {
-			begin = strstr(effect_text->array + diff + 5, "#if 1");
+	if (!trace_enabled)
+		return;
+	const uint64_t frame_time = obs_get_video_frame_time();
+	const uint64_t now = os_gettime_ns();
+	bool dump = false;
+
+	pthread_mutex_lock(&trace_mutex);
+	if (frame_time != trace_frame_time) {
+		if (trace_frame_start) {
+			const uint64_t duration = now - trace_frame_start;
+			trace_push(frame_name, 0, TRACE_THREAD_GRAPHICS, trace_frame_start, duration);
+			if (trace_threshold_ns && duration > trace_threshold_ns &&
+			    now - trace_last_dump > TRACE_DUMP_COOLDOWN_NS) {
+				trace_last_dump = now;
+				dump = true;
+			}
 		}
+		trace_frame_time = frame_time;
+		trace_frame_start = now;
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	if (dump) {
+		blog(LOG_INFO, "[obs-shaderfilter] Frame time exceeded %.1f ms, writing trace",
+		     (double)trace_threshold_ns / 1000000.0);
+		trace_dump_async();
 	}
 }
 
-static void convert_define(struct dstr *effect_text)
+static void shader_filter_update(void *data, obs_data_t *settings);
+
+// obs_source_update only queues the update of a video source for the video thread. Sources created with "offline" in
+// their settings belong to the benchmark or a batch render instead: they are compiled right away on the creating
+// thread, which drives them from then on, and the video thread never updates or ticks them.
+static void shader_filter_initial_update(struct shader_filter_data *filter, obs_data_t *settings)
 {
-	char *pos = strstr(effect_text->array, "#define ");
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *start = pos + 8;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *end = start;
-		while (*end != ' ' && *end != '\t' && *end != '\n' && *end != 0)
-			end++;
-		char *t = strstr(start, "(");
-		if (t && t < end) {
-			// don't replace macro
-			pos = strstr(effect_text->array + diff + 8, "#define ");
-			continue;
-		}
+	filter->offline = obs_data_get_bool(settings, "offline");
+	if (filter->offline)
+		shader_filter_update(filter, settings);
+	else
+		obs_source_update(filter->context, settings);
+}
+
+static void *shader_filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct shader_filter_data *filter = bzalloc(sizeof(struct shader_filter_data));
+	filter->context = source;
+	filter->reload_effect = true;
 
-		struct dstr def_name = {0};
-		dstr_ncat(&def_name, start, end - start);
+	dstr_init(&filter->last_path);
+	dstr_copy(&filter->last_path, obs_data_get_string(settings, "shader_file_name"));
+	filter->last_from_file = obs_data_get_bool(settings, "from_file");
+	filter->rand_instance_f = shader_filter_random(filter);
+	filter->rand_activation_f = shader_filter_random(filter);
+
+	filter->trace_id = os_atomic_inc_long(&trace_next_instance);
+
+	da_init(filter->stored_param_list);
+	load_output_effect(filter);
+	shader_filter_initial_update(filter, settings);
+	filter_registry_add(filter);
+
+	return filter;
+}
+
+#define MIN_AUDIO_THRESHOLD -60.0f
 
-		start = end;
-		while (*start == ' ' || *start == '\t')
-			start++;
+static float convert_db_to_linear(float db_value)
+{
+	if (db_value <= MIN_AUDIO_THRESHOLD || db_value > 0.0f)
+		return 0.0f;
 
-		end = start;
-		while (*end != '\n' && *end != 0 && (*end != '/' || *(end + 1) != '/'))
-			end++;
+	return fmaxf(0.0f, fminf(1.0f, (db_value - MIN_AUDIO_THRESHOLD) / (-MIN_AUDIO_THRESHOLD)));
+}
 
-		t = strstr(start, "(");
-		if (*start == '(' || (t && t < end)) {
-			struct dstr replacement = {0};
-			dstr_ncat(&replacement, start, end - start);
+// audio_spectrum is computed on the audio thread from an audio capture callback on the audio source. Finished spectra
+// are handed to the graphics thread through a triple buffer and uploaded as a bands x 1 texture.
+#define AUDIO_SPECTRUM_MIN_FREQUENCY 20.0
+#define AUDIO_SPECTRUM_MAX_FREQUENCY 20000.0
+#define AUDIO_SPECTRUM_FRESH 4
+
+struct audio_spectrum {
+	size_t fft_size;
+	size_t bands;
+	uint32_t channels;
+
+	float *window;
+	float *twiddle_re;
+	float *twiddle_im;
+	size_t *band_start;
+	size_t *band_end;
+	float *history;
+	size_t history_pos;
+	size_t pending;
+	float *re;
+	float *im;
+
+	float *output[3];
+	long write_index;
+	volatile long middle;
+	long read_index;
+
+	gs_texture_t *texture;
+};
 
-			dstr_remove(effect_text, diff, end - (effect_text->array + diff));
+static struct audio_spectrum *audio_spectrum_create(size_t fft_size, size_t bands, bool log_bins)
+{
+	struct obs_audio_info oai;
+	if (!obs_get_audio_info(&oai))
+		return NULL;
 
-			dstr_replace(effect_text, def_name.array, replacement.array);
+	struct audio_spectrum *spectrum = bzalloc(sizeof(struct audio_spectrum));
+	spectrum->fft_size = fft_size;
+	spectrum->bands = bands;
+	spectrum->channels = get_audio_channels(oai.speakers);
+	spectrum->window = bmalloc(sizeof(float) * fft_size);
+	spectrum->twiddle_re = bmalloc(sizeof(float) * fft_size / 2);
+	spectrum->twiddle_im = bmalloc(sizeof(float) * fft_size / 2);
+	spectrum->band_start = bmalloc(sizeof(size_t) * bands);
+	spectrum->band_end = bmalloc(sizeof(size_t) * bands);
+	spectrum->history = bzalloc(sizeof(float) * fft_size);
+	spectrum->re = bmalloc(sizeof(float) * fft_size);
+	spectrum->im = bmalloc(sizeof(float) * fft_size);
+	for (size_t i = 0; i < 3; i++)
+		spectrum->output[i] = bzalloc(sizeof(float) * bands);
+	spectrum->write_index = 0;
+	spectrum->middle = 1;
+	spectrum->read_index = 2;
+
+	// Hann window, and the twiddle factors for every butterfly size as strides into one table.
+	for (size_t i = 0; i < fft_size; i++)
+		spectrum->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (double)(fft_size - 1)));
+	for (size_t i = 0; i < fft_size / 2; i++) {
+		spectrum->twiddle_re[i] = (float)cos(-2.0 * M_PI * (double)i / (double)fft_size);
+		spectrum->twiddle_im[i] = (float)sin(-2.0 * M_PI * (double)i / (double)fft_size);
+	}
 
-			dstr_free(&replacement);
-			pos = strstr(effect_text->array + diff, "#define ");
+	const size_t bins = fft_size / 2;
+	const double bin_hz = (double)oai.samples_per_sec / (double)fft_size;
+	const double max_frequency = fmin(AUDIO_SPECTRUM_MAX_FREQUENCY, (double)oai.samples_per_sec / 2.0);
+	for (size_t b = 0; b < bands; b++) {
+		double start, end;
+		if (log_bins) {
+			const double ratio = max_frequency / AUDIO_SPECTRUM_MIN_FREQUENCY;
+			start = AUDIO_SPECTRUM_MIN_FREQUENCY * pow(ratio, (double)b / (double)bands) / bin_hz;
+			end = AUDIO_SPECTRUM_MIN_FREQUENCY * pow(ratio, (double)(b + 1) / (double)bands) / bin_hz;
 		} else {
-			pos = strstr(effect_text->array + diff + 8, "#define ");
+			start = (double)bins * (double)b / (double)bands;
+			end = (double)bins * (double)(b + 1) / (double)bands;
 		}
-		dstr_free(&def_name);
+		// Low log bands can be narrower than a bin, they still get the bin they fall in.
+		spectrum->band_start[b] = (size_t)fmin(start, (double)(bins - 1));
+		spectrum->band_end[b] = (size_t)fmin(fmax(end, (double)spectrum->band_start[b] + 1.0), (double)bins);
 	}
+	return spectrum;
 }
 
-static void convert_return(struct dstr *effect_text, struct dstr *var_name, size_t main_diff)
+static void audio_spectrum_destroy(struct audio_spectrum *spectrum)
 {
-	size_t count = 0;
-	char *pos = strstr(effect_text->array + main_diff, var_name->array);
-	while (pos) {
-		if (is_var_char(*(pos - 1)) || (*(pos - 1) == '/' && *(pos - 2) == '/')) {
-			pos = strstr(pos + var_name->len, var_name->array);
-			continue;
+	if (!spectrum)
+		return;
+	if (spectrum->texture) {
+		obs_enter_graphics();
+		gs_texture_destroy(spectrum->texture);
+		obs_leave_graphics();
+	}
+	bfree(spectrum->window);
+	bfree(spectrum->twiddle_re);
+	bfree(spectrum->twiddle_im);
+	bfree(spectrum->band_start);
+	bfree(spectrum->band_end);
+	bfree(spectrum->history);
+	bfree(spectrum->re);
+	bfree(spectrum->im);
+	for (size_t i = 0; i < 3; i++)
+		bfree(spectrum->output[i]);
+	bfree(spectrum);
+}
+
+// In-place iterative radix-2 FFT, n is a power of two.
+static void audio_spectrum_fft(struct audio_spectrum *spectrum)
+{
+	float *re = spectrum->re;
+	float *im = spectrum->im;
+	const size_t n = spectrum->fft_size;
+
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			float t = re[i];
+			re[i] = re[j];
+			re[j] = t;
+			t = im[i];
+			im[i] = im[j];
+			im[j] = t;
 		}
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_name->len;
-		if (*ch == '.') {
-			ch++;
-			while (is_var_char(*ch))
-				ch++;
-		}
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
+	}
 
-		if (*ch == '=' || (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-'))) {
-			count++;
+	for (size_t len = 2; len <= n; len <<= 1) {
+		const size_t half = len / 2;
+		const size_t stride = n / len;
+		for (size_t i = 0; i < n; i += len) {
+			for (size_t k = 0; k < half; k++) {
+				const float wr = spectrum->twiddle_re[k * stride];
+				const float wi = spectrum->twiddle_im[k * stride];
+				const size_t a = i + k;
+				const size_t b = a + half;
+				const float tr = re[b] * wr - im[b] * wi;
+				const float ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
 		}
+	}
+}
 
-		pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
+static void audio_spectrum_analyze(struct audio_spectrum *spectrum)
+{
+	const size_t n = spectrum->fft_size;
+	for (size_t i = 0; i < n; i++) {
+		spectrum->re[i] = spectrum->history[(spectrum->history_pos + i) % n] * spectrum->window[i];
+		spectrum->im[i] = 0.0f;
+	}
+	audio_spectrum_fft(spectrum);
+
+	// Amplitude relative to full scale, the factor 4 makes up for the one sided spectrum and the window gain.
+	const float scale = 4.0f / (float)n;
+	float *output = spectrum->output[spectrum->write_index];
+	for (size_t b = 0; b < spectrum->bands; b++) {
+		float max_power = 0.0f;
+		for (size_t k = spectrum->band_start[b]; k < spectrum->band_end[b]; k++) {
+			const float power = spectrum->re[k] * spectrum->re[k] + spectrum->im[k] * spectrum->im[k];
+			if (power > max_power)
+				max_power = power;
+		}
+		const float amplitude = sqrtf(max_power) * scale;
+		output[b] = amplitude > 0.0f ? convert_db_to_linear(20.0f * log10f(amplitude)) : 0.0f;
 	}
-	if (count == 0)
-		return;
-	if (count == 1) {
-		pos = strstr(effect_text->array + main_diff, var_name->array);
-		while (pos) {
-			if (is_var_char(*(pos - 1)) || (*(pos - 1) == '/' && *(pos - 2) == '/')) {
-				pos = strstr(pos + var_name->len, var_name->array);
-				continue;
-			}
-			size_t diff = pos - effect_text->array;
-			char *ch = pos + var_name->len;
-			if (*ch == '.') {
-				ch++;
-				while (is_var_char(*ch))
-					ch++;
-			}
 
-			while (*ch == ' ' || *ch == '\t')
-				ch++;
+	// Publish the finished spectrum and continue in whatever buffer the graphics thread is not holding.
+	spectrum->write_index = os_atomic_set_long(&spectrum->middle, spectrum->write_index | AUDIO_SPECTRUM_FRESH) & 3;
+}
 
-			if (*ch == '=') {
-				dstr_remove(effect_text, diff, ch - pos + 1);
-				dstr_insert(effect_text, diff, "return ");
-				return;
-			} else if (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-')) {
-				dstr_remove(effect_text, diff, ch - pos + 2);
-				dstr_insert(effect_text, diff, "return ");
-				return;
+static void audio_spectrum_push(struct audio_spectrum *spectrum, const struct audio_data *audio, bool muted)
+{
+	const size_t n = spectrum->fft_size;
+	const uint32_t channels = spectrum->channels ? spectrum->channels : 1;
+	for (uint32_t i = 0; i < audio->frames; i++) {
+		float sample = 0.0f;
+		if (!muted) {
+			for (uint32_t c = 0; c < channels && c < MAX_AV_PLANES; c++) {
+				if (audio->data[c])
+					sample += ((const float *)audio->data[c])[i];
 			}
+			sample /= (float)channels;
+		}
+		spectrum->history[spectrum->history_pos] = sample;
+		spectrum->history_pos = (spectrum->history_pos + 1) % n;
 
-			pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
+		// Half overlapping frames.
+		if (++spectrum->pending >= n / 2) {
+			spectrum->pending = 0;
+			audio_spectrum_analyze(spectrum);
 		}
-		return;
 	}
+}
 
-	size_t replaced = 0;
-	size_t start_diff = 0;
-	bool declared = false;
-	pos = strstr(effect_text->array + main_diff, "{");
-	if (pos) {
-		size_t insert_diff = pos - effect_text->array + 1;
-		dstr_insert(effect_text, insert_diff, " = float4(0.0,0.0,0.0,1.0);\n");
-		dstr_insert(effect_text, insert_diff, var_name->array);
-		dstr_insert(effect_text, insert_diff, "\n\tfloat4 ");
-		declared = true;
-		start_diff = insert_diff - main_diff + 37 + var_name->len;
+// Graphics thread only, uploads at most once per published spectrum.
+static gs_texture_t *audio_spectrum_get_texture(struct audio_spectrum *spectrum)
+{
+	if (!spectrum)
+		return NULL;
+	if (os_atomic_load_long(&spectrum->middle) & AUDIO_SPECTRUM_FRESH) {
+		spectrum->read_index = os_atomic_set_long(&spectrum->middle, spectrum->read_index) & 3;
+		if (!spectrum->texture)
+			spectrum->texture = gs_texture_create((uint32_t)spectrum->bands, 1, GS_R32F, 1, NULL, GS_DYNAMIC);
+		if (spectrum->texture)
+			gs_texture_set_image(spectrum->texture, (const uint8_t *)spectrum->output[spectrum->read_index],
+					     (uint32_t)(spectrum->bands * sizeof(float)), false);
 	}
+	return spectrum->texture;
+}
 
-	pos = strstr(effect_text->array + main_diff + start_diff, var_name->array);
-	while (pos) {
-		size_t diff = pos - effect_text->array;
-		char *ch = pos + var_name->len;
-		bool part = false;
-		if (*ch == '.') {
-			part = true;
-			ch++;
-			while (is_var_char(*ch))
-				ch++;
+// Beat analysis runs on the audio thread once per audio buffer: three biquad band filters for bass, mid and treble
+// energy, onsets where the low energy rises above an adaptive threshold, and the tempo from the intervals between them.
+enum audio_beat_filter_type { AUDIO_BEAT_LOWPASS, AUDIO_BEAT_BANDPASS, AUDIO_BEAT_HIGHPASS };
+
+static void audio_beat_set_filter(struct audio_beat *beat, size_t band, enum audio_beat_filter_type type, double frequency, double q)
+{
+	const double w0 = 2.0 * M_PI * frequency / (double)beat->sample_rate;
+	const double cos_w0 = cos(w0);
+	const double alpha = sin(w0) / (2.0 * q);
+	const double a0 = 1.0 + alpha;
+	double b0, b1, b2;
+	switch (type) {
+	case AUDIO_BEAT_LOWPASS:
+		b0 = (1.0 - cos_w0) / 2.0;
+		b1 = 1.0 - cos_w0;
+		b2 = b0;
+		break;
+	case AUDIO_BEAT_BANDPASS:
+		b0 = alpha;
+		b1 = 0.0;
+		b2 = -alpha;
+		break;
+	default:
+		b0 = (1.0 + cos_w0) / 2.0;
+		b1 = -(1.0 + cos_w0);
+		b2 = b0;
+	}
+	beat->b0[band] = (float)(b0 / a0);
+	beat->b1[band] = (float)(b1 / a0);
+	beat->b2[band] = (float)(b2 / a0);
+	beat->a1[band] = (float)(-2.0 * cos_w0 / a0);
+	beat->a2[band] = (float)((1.0 - alpha) / a0);
+}
+
+static void audio_beat_reset(struct audio_beat *beat, uint32_t sample_rate)
+{
+	memset(beat, 0, sizeof(struct audio_beat));
+	beat->sample_rate = sample_rate;
+	audio_beat_set_filter(beat, 0, AUDIO_BEAT_LOWPASS, 150.0, 0.707);
+	audio_beat_set_filter(beat, 1, AUDIO_BEAT_BANDPASS, 800.0, 0.5);
+	audio_beat_set_filter(beat, 2, AUDIO_BEAT_HIGHPASS, 2500.0, 0.707);
+}
+
+static int audio_beat_compare_interval(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *)a;
+	const uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// samples is the mono mix of the buffer, band levels are written normalized like audio_peak.
+static void audio_beat_process(struct audio_beat *beat, const float *samples, uint32_t frames, uint64_t timestamp,
+			       struct audio_levels *levels)
+{
+	float energy[AUDIO_BEAT_BANDS] = {0};
+	for (uint32_t i = 0; i < frames; i++) {
+		const float x = samples[i];
+		// Transposed direct form II, the band loop is independent per lane.
+		for (size_t b = 0; b < AUDIO_BEAT_BANDS; b++) {
+			const float y = beat->b0[b] * x + beat->z1[b];
+			beat->z1[b] = beat->b1[b] * x - beat->a1[b] * y + beat->z2[b];
+			beat->z2[b] = beat->b2[b] * x - beat->a2[b] * y;
+			energy[b] += y * y;
 		}
-		while (*ch == ' ' || *ch == '\t')
-			ch++;
+	}
+	float level[AUDIO_BEAT_BANDS];
+	for (size_t b = 0; b < AUDIO_BEAT_BANDS; b++) {
+		energy[b] /= (float)frames;
+		level[b] = energy[b] > 0.0f ? convert_db_to_linear(10.0f * log10f(energy[b])) : 0.0f;
+	}
+	levels->bass = level[0];
+	levels->mid = level[1];
+	levels->treble = level[2];
+
+	// Adaptive threshold from a running mean and variance over roughly the last second.
+	const float low_energy = energy[0] + energy[1];
+	const float deviation = sqrtf(beat->energy_var);
+	const bool onset = low_energy > beat->energy_mean + 1.5f * deviation && low_energy > beat->energy_mean * 1.3f &&
+			   (level[0] > 0.0f || level[1] > 0.0f) &&
+			   (!beat->last_onset || timestamp - beat->last_onset > AUDIO_BEAT_REFRACTORY_NS);
+	const float rate = fminf(1.0f, (float)frames / (float)beat->sample_rate);
+	const float diff = low_energy - beat->energy_mean;
+	beat->energy_mean += rate * diff;
+	beat->energy_var = (1.0f - rate) * (beat->energy_var + rate * diff * diff);
+
+	if (onset) {
+		const uint64_t interval = beat->last_onset ? timestamp - beat->last_onset : 0;
+		if (interval >= AUDIO_BEAT_MIN_INTERVAL_NS && interval <= AUDIO_BEAT_MAX_INTERVAL_NS) {
+			beat->intervals[beat->interval_pos] = interval;
+			beat->interval_pos = (beat->interval_pos + 1) % AUDIO_BEAT_INTERVALS;
+			if (beat->interval_count < AUDIO_BEAT_INTERVALS)
+				beat->interval_count++;
+
+			// The median interval is robust against missed and extra onsets.
+			uint64_t sorted[AUDIO_BEAT_INTERVALS];
+			memcpy(sorted, beat->intervals, sizeof(uint64_t) * beat->interval_count);
+			qsort(sorted, beat->interval_count, sizeof(uint64_t), audio_beat_compare_interval);
+			beat->period = (float)((double)sorted[beat->interval_count / 2] / 1000000000.0);
+		}
+		beat->last_onset = timestamp;
+	}
+	levels->last_onset = beat->last_onset;
+	levels->beat_period = beat->period;
+}
 
-		if (*ch == '=') {
-			replaced++;
-			if (replaced == 1 && !declared) {
-				if (part) {
-					dstr_insert(effect_text, diff, " = float4(0.0,0.0,0.0,1.0);\n");
-					dstr_insert(effect_text, diff, var_name->array);
-					dstr_insert(effect_text, diff, "float4 ");
-					diff += 35 + var_name->len;
-				} else {
-					dstr_insert(effect_text, diff, "float4 ");
-					diff += 7;
-				}
-			} else if (replaced == count) {
-				if (part) {
-					while (*ch != ';' && *ch != 0)
-						ch++;
-					diff = ch - effect_text->array + 1;
-					dstr_insert(effect_text, diff, ";");
-					dstr_insert(effect_text, diff, var_name->array);
-					dstr_insert(effect_text, diff, "\n\treturn ");
-				} else {
-					dstr_remove(effect_text, diff, ch - pos + 1);
-					dstr_insert(effect_text, diff, "return ");
-				}
-				return;
-			}
-		} else if (*(ch + 1) == '=' && (*ch == '*' || *ch == '/' || *ch == '+' || *ch == '-')) {
-			replaced++;
-			if (replaced == 1 && !declared) {
-				dstr_insert(effect_text, diff, " = float4(0.0,0.0,0.0,1.0);\n");
-				dstr_insert(effect_text, diff, var_name->array);
-				dstr_insert(effect_text, diff, "float4 ");
-				diff += 35 + var_name->len;
-			} else if (replaced == count) {
-				while (*ch != ';' && *ch != 0)
-					ch++;
-				diff = ch - effect_text->array + 1;
-				dstr_insert(effect_text, diff, ";");
-				dstr_insert(effect_text, diff, var_name->array);
-				dstr_insert(effect_text, diff, "\n\treturn ");
-				return;
-			}
+// Single producer: only the audio thread writes the ring, publishing each entry by advancing audio_levels_written.
+static void shader_filter_push_audio_levels(struct shader_filter_data *filter, obs_source_t *source,
+					    const struct audio_data *audio, bool muted)
+{
+	const uint32_t channels = filter->audio_channels;
+	const float volume = muted ? 0.0f : obs_source_get_volume(source);
+	const uint32_t sample_rate = filter->audio_sample_rate;
+
+	float peak = 0.0f;
+	for (uint32_t c = 0; c < channels && c < MAX_AV_PLANES; c++) {
+		const float *samples = (const float *)audio->data[c];
+		if (!samples || !audio->frames)
+			continue;
+		float channel_peak = 0.0f;
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < audio->frames; i++) {
+			const float sample = samples[i];
+			channel_peak = fmaxf(channel_peak, fabsf(sample));
+			sum += sample * sample;
 		}
+		peak = fmaxf(peak, channel_peak * volume);
+		filter->audio_window_sum[c] += sum * volume * volume;
+	}
 
-		pos = strstr(effect_text->array + diff + var_name->len, var_name->array);
+	// The RMS is taken over the same window as the OBS volume meter, independent of the buffer size.
+	filter->audio_window_frames += audio->frames;
+	if (filter->audio_window_frames >= sample_rate * AUDIO_MAGNITUDE_WINDOW_MS / 1000) {
+		float magnitude = 0.0f;
+		for (uint32_t c = 0; c < channels && c < MAX_AV_PLANES; c++) {
+			magnitude = fmaxf(magnitude, sqrtf(filter->audio_window_sum[c] / (float)filter->audio_window_frames));
+			filter->audio_window_sum[c] = 0.0f;
+		}
+		filter->audio_window_magnitude = magnitude;
+		filter->audio_window_frames = 0;
+	}
+	const float magnitude = filter->audio_window_magnitude;
+
+	const long written = os_atomic_load_long(&filter->audio_levels_written);
+	struct audio_levels *levels = &filter->audio_levels[written % AUDIO_LEVELS_RING];
+	memset(levels, 0, sizeof(struct audio_levels));
+	levels->timestamp = audio->timestamp;
+	const bool beats = os_atomic_load_bool(&filter->audio_beats);
+	if (!beats)
+		filter->audio_beats_running = false;
+	if (beats && audio->frames && sample_rate) {
+		if (!filter->audio_beats_running || filter->audio_beat.sample_rate != sample_rate)
+			audio_beat_reset(&filter->audio_beat, sample_rate);
+		filter->audio_beats_running = true;
+		float *mono = filter->audio_mono;
+		if (filter->audio_mono_size < audio->frames) {
+			mono = brealloc(filter->audio_mono, sizeof(float) * audio->frames);
+			filter->audio_mono = mono;
+			filter->audio_mono_size = audio->frames;
+		}
+		for (uint32_t i = 0; i < audio->frames; i++) {
+			float sample = 0.0f;
+			for (uint32_t c = 0; c < channels && c < MAX_AV_PLANES; c++) {
+				if (audio->data[c])
+					sample += ((const float *)audio->data[c])[i];
+			}
+			mono[i] = sample * volume / (float)channels;
+		}
+		audio_beat_process(&filter->audio_beat, mono, audio->frames, audio->timestamp, levels);
 	}
+	levels->peak = peak > 0.0f ? convert_db_to_linear(20.0f * log10f(peak)) : 0.0f;
+	levels->magnitude = magnitude > 0.0f ? convert_db_to_linear(20.0f * log10f(magnitude)) : 0.0f;
+	os_atomic_set_long(&filter->audio_levels_written, written + 1);
 }
 
-static bool shader_filter_convert(obs_properties_t *props, obs_property_t *property, void *data)
+static void shader_filter_audio_capture(void *data, obs_source_t *source, const struct audio_data *audio, bool muted)
 {
-	UNUSED_PARAMETER(props);
-	if (!data)
-		return false;
 	struct shader_filter_data *filter = data;
-	obs_data_t *settings = obs_source_get_settings(filter->context);
-	if (!settings)
-		return false;
-	struct dstr effect_text = {0};
-	dstr_init_copy(&effect_text, obs_data_get_string(settings, "shader_text"));
+	const uint64_t trace_start = trace_begin();
+	shader_filter_push_audio_levels(filter, source, audio, muted);
+	if (filter->audio_spectrum)
+		audio_spectrum_push(filter->audio_spectrum, audio, muted);
+	trace_end(audio_capture_name, filter->trace_id, TRACE_THREAD_AUDIO, trace_start);
+}
 
-	//convert_define(&effect_text);
+// Picks the newest levels that are not ahead of the video frame, then applies attack/release smoothing.
+static void shader_filter_tick_audio_levels(struct shader_filter_data *filter, float seconds)
+{
+	const long written = os_atomic_load_long(&filter->audio_levels_written);
+	if (!filter->audio_capture || !written) {
+		filter->audio_peak = 0.0f;
+		filter->audio_magnitude = 0.0f;
+		filter->audio_bass = 0.0f;
+		filter->audio_mid = 0.0f;
+		filter->audio_treble = 0.0f;
+		filter->audio_beat_value = 0.0f;
+		filter->audio_beat_phase = 0.0f;
+		filter->audio_bpm = 0.0f;
+		return;
+	}
 
-	size_t start_diff = 24;
-	bool main_no_args = false;
-	int uv = 0;
-	char *main_pos = strstr(effect_text.array, "void mainImage(out vec4");
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "void mainImage( out vec4");
-		start_diff++;
+	const uint64_t frame_time = obs_get_video_frame_time();
+	const long oldest = written > AUDIO_LEVELS_RING / 2 ? written - AUDIO_LEVELS_RING / 2 : 0;
+	const struct audio_levels *levels = &filter->audio_levels[(written - 1) % AUDIO_LEVELS_RING];
+	for (long i = written - 1; i >= oldest; i--) {
+		levels = &filter->audio_levels[i % AUDIO_LEVELS_RING];
+		if (levels->timestamp <= frame_time)
+			break;
 	}
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "void main()");
-		if (main_pos)
-			main_no_args = true;
+
+	const float attack = filter->audio_attack > 0.0f ? 1.0f - expf(-seconds / filter->audio_attack) : 1.0f;
+	const float release = filter->audio_release > 0.0f ? 1.0f - expf(-seconds / filter->audio_release) : 1.0f;
+	filter->audio_peak += (levels->peak - filter->audio_peak) * (levels->peak > filter->audio_peak ? attack : release);
+	filter->audio_magnitude += (levels->magnitude - filter->audio_magnitude) *
+				   (levels->magnitude > filter->audio_magnitude ? attack : release);
+	if (!os_atomic_load_bool(&filter->audio_beats)) {
+		filter->audio_beats_ticking = false;
+		return;
 	}
-	if (!main_pos) {
-		main_pos = strstr(effect_text.array, "vec4 effect(vec4");
-		start_diff = 17;
-		uv = 1;
+	if (!filter->audio_beats_ticking) {
+		filter->audio_bass = 0.0f;
+		filter->audio_mid = 0.0f;
+		filter->audio_treble = 0.0f;
+		filter->audio_beat_value = 0.0f;
+		filter->audio_beat_phase = 0.0f;
+		filter->audio_bpm = 0.0f;
+		filter->audio_last_onset = 0;
+		filter->audio_beats_ticking = true;
 	}
 
-	if (!main_pos) {
-		dstr_free(&effect_text);
-		obs_data_release(settings);
-		return false;
+	filter->audio_bass += (levels->bass - filter->audio_bass) * (levels->bass > filter->audio_bass ? attack : release);
+	filter->audio_mid += (levels->mid - filter->audio_mid) * (levels->mid > filter->audio_mid ? attack : release);
+	filter->audio_treble += (levels->treble - filter->audio_treble) *
+				(levels->treble > filter->audio_treble ? attack : release);
+
+	// audio_beat jumps to 1 on an onset and decays over about 150 ms, audio_beat_phase runs 0-1 between expected beats.
+	if (levels->last_onset && levels->last_onset != filter->audio_last_onset) {
+		filter->audio_last_onset = levels->last_onset;
+		filter->audio_beat_value = 1.0f;
+	} else {
+		filter->audio_beat_value *= expf(-seconds / 0.15f);
 	}
-	size_t main_diff = main_pos - effect_text.array;
-	struct dstr return_color_name = {0};
-	struct dstr coord_name = {0};
-	if (main_no_args) {
-
-		dstr_replace(&effect_text, "void main()", "float4 mainImage(VertData v_in) : TARGET");
-		if (strstr(effect_text.array, "varying vec2 position;")) {
-			uv = 1;
-			dstr_init_copy(&coord_name, "position");
-		} else if (strstr(effect_text.array, "varying vec2 pos;")) {
-			uv = 1;
-			dstr_init_copy(&coord_name, "pos");
-		} else if (strstr(effect_text.array, "fNormal")) {
-			uv = 2;
-			dstr_init_copy(&coord_name, "fNormal");
-		} else {
-			uv = 0;
-			dstr_init_copy(&coord_name, "gl_FragCoord");
-		}
-
-		char *out_start = strstr(effect_text.array, "out vec4");
-		if (out_start) {
-			char *start = out_start + 9;
-			while (*start == ' ' || *start == '\t')
-				start++;
-			char *end = start;
-			while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != '(' && *end != ')' &&
-			       *end != ';' && *end != 0)
-				end++;
-			dstr_ncat(&return_color_name, start, end - start);
-			while (*end == ' ' || *end == '\t')
-				end++;
-			if (*end == ';')
-				dstr_remove(&effect_text, out_start - effect_text.array, (end + 1) - out_start);
-		} else {
-			dstr_init_copy(&return_color_name, "gl_FragColor");
-		}
+	filter->audio_bpm = levels->beat_period > 0.0f ? 60.0f / levels->beat_period : 0.0f;
+	if (levels->beat_period > 0.0f && filter->audio_last_onset && frame_time > filter->audio_last_onset) {
+		const double since = (double)(frame_time - filter->audio_last_onset) / 1000000000.0;
+		filter->audio_beat_phase = (float)fmod(since / levels->beat_period, 1.0);
 	} else {
+		filter->audio_beat_phase = 0.0f;
+	}
+}
 
-		char *start = main_pos + start_diff;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *end = start;
-		while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != ')' && *end != 0)
-			end++;
-
-		dstr_ncat(&return_color_name, start, end - start);
-
-		start = strstr(end, ",");
-		if (!start) {
-			dstr_free(&effect_text);
-			dstr_free(&return_color_name);
-			obs_data_release(settings);
-			return false;
-		}
-		start++;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *v2i = strstr(start, "in vec2 ");
-		char *v2 = strstr(start, "vec2 ");
-		char *close = strstr(start, ")");
-		if (v2i && close && v2i < close) {
-			start = v2i + 8;
-		} else if (v2 && close && v2 < close) {
-			start = v2 + 5;
-		} else {
-			if (*start == 'i' && *(start + 1) == 'n' && (*(start + 2) == ' ' || *(start + 2) == '\t'))
-				start += 3;
-			while (*start == ' ' || *start == '\t')
-				start++;
-			if (*start == 'v' && *(start + 1) == 'e' && *(start + 2) == 'c' && *(start + 3) == '2' &&
-			    (*(start + 4) == ' ' || *(start + 4) == '\t'))
-				start += 5;
-		}
-		while (*start == ' ' || *start == '\t')
-			start++;
-
-		end = start;
-		while (*end != ' ' && *end != '\t' && *end != '\n' && *end != ',' && *end != ')' && *end != 0)
-			end++;
+// Capture callbacks are removed under the source's callback lock, so once detached the analyzers can be swapped safely.
+static void shader_filter_detach_audio_capture(struct shader_filter_data *filter)
+{
+	if (!filter->audio_capture)
+		return;
+	obs_source_t *source = obs_weak_source_get_source(filter->audio_capture);
+	if (source) {
+		obs_source_remove_audio_capture_callback(source, shader_filter_audio_capture, filter);
+		obs_source_release(source);
+	}
+	obs_weak_source_release(filter->audio_capture);
+	filter->audio_capture = NULL;
+}
 
-		dstr_ncat(&coord_name, start, end - start);
+static void shader_filter_update_audio_capture(struct shader_filter_data *filter, obs_data_t *settings, obs_source_t *source)
+{
+	const bool use_capture = source != NULL;
+	const bool use_spectrum = source && filter->param_audio_spectrum;
+	size_t fft_size = (size_t)obs_data_get_int(settings, "audio_fft_size");
+	if (fft_size < 256 || fft_size > 8192 || (fft_size & (fft_size - 1)) != 0)
+		fft_size = 2048;
+	size_t bands = (size_t)obs_data_get_int(settings, "audio_spectrum_bands");
+	if (bands < 1 || bands > fft_size / 2)
+		bands = 64;
+	const bool log_bins = obs_data_get_bool(settings, "audio_spectrum_log");
+
+	const bool same_source = filter->audio_capture && obs_weak_source_references_source(filter->audio_capture, source);
+	const bool same_spectrum = !use_spectrum || (filter->audio_spectrum && filter->audio_spectrum->fft_size == fft_size &&
+						     filter->audio_spectrum->bands == bands &&
+						     filter->audio_spectrum_log == log_bins);
+	if (use_capture && same_source && same_spectrum)
+		return;
 
-		while (*end != ')' && *end != 0)
-			end++;
-		size_t idx = main_pos - effect_text.array;
-		dstr_remove(&effect_text, idx, end - main_pos + 1);
-		dstr_insert(&effect_text, idx, "float4 mainImage(VertData v_in) : TARGET");
+	shader_filter_detach_audio_capture(filter);
+	if (!same_spectrum || !use_spectrum) {
+		struct audio_spectrum *spectrum = use_spectrum ? audio_spectrum_create(fft_size, bands, log_bins) : NULL;
+		obs_enter_graphics();
+		struct audio_spectrum *old_spectrum = filter->audio_spectrum;
+		filter->audio_spectrum = spectrum;
+		obs_leave_graphics();
+		audio_spectrum_destroy(old_spectrum);
+		filter->audio_spectrum_log = log_bins;
 	}
+	if (use_capture) {
+		struct obs_audio_info oai;
+		const bool have_info = obs_get_audio_info(&oai);
+		filter->audio_channels = have_info ? get_audio_channels(oai.speakers) : 2;
+		filter->audio_sample_rate = have_info ? oai.samples_per_sec : 48000;
+		memset(filter->audio_window_sum, 0, sizeof(filter->audio_window_sum));
+		filter->audio_window_frames = 0;
+		filter->audio_window_magnitude = 0.0f;
+		os_atomic_set_long(&filter->audio_levels_written, 0);
+		filter->audio_capture = obs_source_get_weak_source(source);
+		obs_source_add_audio_capture_callback(source, shader_filter_audio_capture, filter);
+	}
+}
 
-	convert_return(&effect_text, &return_color_name, main_diff);
+// Output capture: the output texture is copied into one of CAPTURE_RING staging surfaces and read back CAPTURE_RING
+// frames later, when the copy has finished, so rendering never waits for the GPU. Frames are encoded and written by a
+// worker thread; when its queue is full the frame is dropped instead of blocking the graphics thread.
+#define CAPTURE_RING 3
+#define CAPTURE_QUEUE 8
+
+struct capture_frame {
+	uint8_t *data;
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t index;
+};
 
-	dstr_free(&return_color_name);
+struct output_capture {
+	// Graphics thread.
+	gs_stagesurf_t *surfaces[CAPTURE_RING];
+	uint64_t staged_index[CAPTURE_RING];
+	bool staged[CAPTURE_RING];
+	size_t next;
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t frame_count;
+	volatile long interval;
+
+	// Worker thread.
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	pthread_mutex_t mutex;
+	struct capture_frame queue[CAPTURE_QUEUE];
+	size_t queue_head;
+	size_t queue_count;
+	bool stop;
+	char *prefix;
+	bool png;
+	// Wait for the worker instead of dropping frames, for offline rendering.
+	bool lossless;
+
+	volatile long captured;
+	volatile long dropped;
+};
 
-	if (dstr_cmp(&coord_name, "fragCoord") != 0) {
-		if (dstr_find(&coord_name, "fragCoord")) {
-			dstr_replace(&effect_text, coord_name.array, "fragCoord");
-		} else {
-			char *pos = strstr(effect_text.array, coord_name.array);
-			while (pos) {
-				size_t diff = pos - effect_text.array;
-				if (((main_no_args || diff < main_diff) || diff > main_diff + 24) && !is_var_char(*(pos - 1)) &&
-				    !is_var_char(*(pos + coord_name.len))) {
-					dstr_remove(&effect_text, diff, coord_name.len);
-					dstr_insert(&effect_text, diff, "fragCoord");
-					pos = strstr(effect_text.array + diff + 9, coord_name.array);
+static void write_png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t size)
+{
+	const uint8_t length[4] = {(uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size};
+	uint32_t crc = calc_crc32(0, type, 4);
+	crc = calc_crc32(crc, data, size);
+	const uint8_t crc_bytes[4] = {(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc};
+	fwrite(length, 1, 4, file);
+	fwrite(type, 1, 4, file);
+	fwrite(data, 1, size, file);
+	fwrite(crc_bytes, 1, 4, file);
+}
 
-				} else {
-					pos = strstr(effect_text.array + diff + coord_name.len, coord_name.array);
-				}
+// 8-bit RGBA PNG with an uncompressed (stored) deflate stream: valid everywhere and cheap to produce, at the size of
+// the raw pixels.
+static bool write_png(const char *path, const uint8_t *data, uint32_t cx, uint32_t cy)
+{
+	FILE *file = os_fopen(path, "wb");
+	if (!file)
+		return false;
+
+	const size_t row = (size_t)cx * 4;
+	const size_t raw_size = (row + 1) * cy;
+	const size_t blocks = (raw_size + 65534) / 65535;
+	const size_t zlib_size = 2 + raw_size + blocks * 5 + 4;
+	uint8_t *zlib = bmalloc(zlib_size);
+	uint8_t *out = zlib;
+	*out++ = 0x78;
+	*out++ = 0x01;
+
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	size_t block_left = 0;
+	size_t remaining = raw_size;
+	for (uint32_t y = 0; y < cy; y++) {
+		for (size_t x = 0; x <= row; x++) {
+			if (!block_left) {
+				block_left = remaining < 65535 ? remaining : 65535;
+				*out++ = remaining == block_left ? 1 : 0;
+				*out++ = (uint8_t)block_left;
+				*out++ = (uint8_t)(block_left >> 8);
+				*out++ = (uint8_t)~block_left;
+				*out++ = (uint8_t)(~block_left >> 8);
 			}
+			// Every row starts with filter type 0.
+			const uint8_t byte = x ? data[y * row + x - 1] : 0;
+			*out++ = byte;
+			adler_a = (adler_a + byte) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+			block_left--;
+			remaining--;
 		}
 	}
-	dstr_free(&coord_name);
+	const uint32_t adler = (adler_b << 16) | adler_a;
+	*out++ = (uint8_t)(adler >> 24);
+	*out++ = (uint8_t)(adler >> 16);
+	*out++ = (uint8_t)(adler >> 8);
+	*out++ = (uint8_t)adler;
+
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	const uint8_t header[13] = {(uint8_t)(cx >> 24), (uint8_t)(cx >> 16), (uint8_t)(cx >> 8), (uint8_t)cx,
+				    (uint8_t)(cy >> 24), (uint8_t)(cy >> 16), (uint8_t)(cy >> 8), (uint8_t)cy,
+				    8, 6, 0, 0, 0};
+	fwrite(signature, 1, sizeof(signature), file);
+	write_png_chunk(file, "IHDR", header, sizeof(header));
+	write_png_chunk(file, "IDAT", zlib, (uint32_t)zlib_size);
+	write_png_chunk(file, "IEND", NULL, 0);
+	bfree(zlib);
+
+	const bool success = ferror(file) == 0;
+	fclose(file);
+	return success;
+}
 
-	convert_if0(&effect_text);
-	convert_if1(&effect_text);
+static bool write_raw(const char *path, const uint8_t *data, uint32_t cx, uint32_t cy)
+{
+	FILE *file = os_fopen(path, "wb");
+	if (!file)
+		return false;
+	const size_t size = (size_t)cx * cy * 4;
+	const bool success = fwrite(data, 1, size, file) == size;
+	fclose(file);
+	return success;
+}
 
-	dstr_replace(&effect_text, "varying vec3", "//varying vec3");
-	dstr_replace(&effect_text, "precision highp float;", "//precision highp float;");
-	if (uv == 1) {
-		dstr_replace(&effect_text, "fragCoord", "v_in.uv");
-	} else if (uv == 2) {
-		dstr_replace(&effect_text, "fragCoord.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord", "float3(v_in.uv,0.0)");
-	} else {
-		dstr_replace(&effect_text, "fragCoord.xy/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord.xy / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "fragCoord", "(v_in.uv * uv_size)");
-		dstr_replace(&effect_text, "gl_FragCoord.xy/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord.xy / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord/iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord / iResolution.xy", "v_in.uv");
-		dstr_replace(&effect_text, "gl_FragCoord", "(v_in.uv * uv_size)");
-	}
-	dstr_replace(&effect_text, "love_ScreenSize", "uv_size");
-	dstr_replace(&effect_text, "u_resolution", "uv_size");
-	dstr_replace(&effect_text, "uResolution", "uv_size");
-	dstr_replace(&effect_text, "iResolution.xyz", "float3(uv_size,0.0)");
-	dstr_replace(&effect_text, "iResolution.xy", "uv_size");
-	dstr_replace(&effect_text, "iResolution.x", "uv_size.x");
-	dstr_replace(&effect_text, "iResolution.y", "uv_size.y");
-	dstr_replace(&effect_text, "iResolution", "float4(uv_size,uv_pixel_interval)");
-
-	dstr_replace(&effect_text, "uniform vec2 uv_size;", "");
-
-	if (strstr(effect_text.array, "iTime"))
-		dstr_replace(&effect_text, "iTime", "elapsed_time");
-	else if (strstr(effect_text.array, "uTime"))
-		dstr_replace(&effect_text, "uTime", "elapsed_time");
-	else if (strstr(effect_text.array, "u_time"))
-		dstr_replace(&effect_text, "u_time", "elapsed_time");
-	else
-		dstr_replace(&effect_text, "time", "elapsed_time");
-
-	dstr_replace(&effect_text, "uniform float elapsed_time;", "");
-
-	dstr_replace(&effect_text, "iDate.w", "local_time");
-
-	dstr_replace(&effect_text, "bvec2", "bool2");
-	dstr_replace(&effect_text, "bvec3", "bool3");
-	dstr_replace(&effect_text, "bvec4", "bool4");
-
-	dstr_replace(&effect_text, "ivec4", "int4");
-	dstr_replace(&effect_text, "ivec3", "int3");
-	dstr_replace(&effect_text, "ivec2", "int2");
-
-	dstr_replace(&effect_text, "uvec4", "uint4");
-	dstr_replace(&effect_text, "uvec3", "uint3");
-	dstr_replace(&effect_text, "uvec2", "uint2");
-
-	dstr_replace(&effect_text, "vec4", "float4");
-	dstr_replace(&effect_text, "vec3", "float3");
-	dstr_replace(&effect_text, "vec2", "float2");
-
-	dstr_replace(&effect_text, " number ", " float ");
-
-	//dstr_replace(&effect_text, "mat4", "float4x4");
-	//dstr_replace(&effect_text, "mat3", "float3x3");
-	//dstr_replace(&effect_text, "mat2", "float2x2");
-
-	dstr_replace(&effect_text, "dFdx(", "ddx(");
-	dstr_replace(&effect_text, "dFdy(", "ddy(");
-	dstr_replace(&effect_text, "mix(", "lerp(");
-	dstr_replace(&effect_text, "fract(", "frac(");
-	dstr_replace(&effect_text, "inversesqrt(", "rsqrt(");
-
-	dstr_replace(&effect_text, "extern bool", "uniform bool");
-	dstr_replace(&effect_text, "extern uint", "uniform uint");
-	dstr_replace(&effect_text, "extern int", "uniform int");
-	dstr_replace(&effect_text, "extern float", "uniform float");
-
-	convert_init(&effect_text, "bool");
-	convert_init(&effect_text, "uint");
-	convert_init(&effect_text, "int");
-	convert_init(&effect_text, "float");
-
-	convert_vector_init(&effect_text, "bool(", 1);
-	convert_vector_init(&effect_text, "bool2(", 2);
-	convert_vector_init(&effect_text, "bool3(", 3);
-	convert_vector_init(&effect_text, "bool4(", 4);
-	convert_vector_init(&effect_text, "uint(", 1);
-	convert_vector_init(&effect_text, "uint2(", 2);
-	convert_vector_init(&effect_text, "uint3(", 3);
-	convert_vector_init(&effect_text, "uint4(", 4);
-	convert_vector_init(&effect_text, "int(", 1);
-	convert_vector_init(&effect_text, "int2(", 2);
-	convert_vector_init(&effect_text, "int3(", 3);
-	convert_vector_init(&effect_text, "int4(", 4);
-	convert_vector_init(&effect_text, "float(", 1);
-	convert_vector_init(&effect_text, "float2(", 2);
-	convert_vector_init(&effect_text, "float3(", 3);
-	convert_vector_init(&effect_text, "float4(", 4);
-	convert_vector_init(&effect_text, "mat2(", 4);
-	convert_vector_init(&effect_text, "mat3(", 9);
-	convert_vector_init(&effect_text, "mat4(", 16);
-
-	convert_atan(&effect_text);
-	convert_mat_mul(&effect_text, "mat2");
-	convert_mat_mul(&effect_text, "mat3");
-	convert_mat_mul(&effect_text, "mat4");
-
-	dstr_replace(&effect_text, "point(", "point2(");
-	dstr_replace(&effect_text, "line(", "line2(");
-
-	dstr_replace(&effect_text, "#version ", "//#version ");
-
-	convert_if_defined(&effect_text);
-
-	dstr_replace(&effect_text, "acos(-1.0)", "3.14159265359");
-	dstr_replace(&effect_text, "acos(-1.)", "3.14159265359");
-	dstr_replace(&effect_text, "acos(-1)", "3.14159265359");
-
-	struct dstr insert_text = {0};
-	dstr_init_copy(&insert_text, "#ifndef OPENGL\n");
-
-	if (dstr_find(&effect_text, "mat2"))
-		dstr_cat(&insert_text, "#define mat2 float2x2\n");
-	if (dstr_find(&effect_text, "mat3"))
-		dstr_cat(&insert_text, "#define mat3 float3x3\n");
-	if (dstr_find(&effect_text, "mat4"))
-		dstr_cat(&insert_text, "#define mat4 float4x4\n");
-
-	if (dstr_find(&effect_text, "mod("))
-		dstr_cat(&insert_text, "#define mod(x,y) (x - y * floor(x / y))\n");
-	if (dstr_find(&effect_text, "lessThan("))
-		dstr_cat(&insert_text, "#define lessThan(a,b) (a < b)\n");
-	if (dstr_find(&effect_text, "greaterThan("))
-		dstr_cat(&insert_text, "#define greaterThan(a,b) (a > b)\n");
-	dstr_cat(&insert_text, "#endif\n");
-
-	if (dstr_find(&effect_text, "iMouse") && !dstr_find(&effect_text, "float2 iMouse"))
-		dstr_cat(
-			&insert_text,
-			"uniform float4 iMouse<\nstring widget_type = \"slider\";\nfloat minimum=0.0;\nfloat maximum=1000.0;\nfloat step=1.0;\n>;\n");
-
-	if (dstr_find(&effect_text, "iFrame") && !dstr_find(&effect_text, "float iFrame"))
-		dstr_cat(&insert_text, "uniform float iFrame;\n");
-
-	if (dstr_find(&effect_text, "iSampleRate") && !dstr_find(&effect_text, "float iSampleRate"))
-		dstr_cat(&insert_text, "uniform float iSampleRate;\n");
-
-	if (dstr_find(&effect_text, "iTimeDelta") && !dstr_find(&effect_text, "float iTimeDelta"))
-		dstr_cat(&insert_text, "uniform float iTimeDelta;\n");
-
-	int num_textures = 0;
-	struct dstr texture_name = {0};
-	struct dstr replacing = {0};
-	struct dstr replacement = {0};
-
-	char *texture_find[] = {"texture(", "texture2D(", "texelFetch(", "Texel(", "textureLod("};
-	char *texture = NULL;
-	size_t texture_diff = 0;
-	for (size_t i = 0; i < sizeof(texture_find) / sizeof(char *); i++) {
-		char *t = strstr(effect_text.array, texture_find[i]);
-		if (t && (!texture || t < texture)) {
-			texture = t;
-			texture_diff = strlen(texture_find[i]);
-		}
-	}
-	while (texture) {
-		const size_t diff = texture - effect_text.array;
-		if (is_var_char(*(texture - 1))) {
-			texture = NULL;
-			size_t prev_diff = texture_diff;
-			for (size_t i = 0; i < 3; i++) {
-				char *t = strstr(effect_text.array + diff + prev_diff, texture_find[i]);
-				if (t && (!texture || t < texture)) {
-					texture = t;
-					texture_diff = strlen(texture_find[i]);
-				}
-			}
+static void *output_capture_thread(void *data)
+{
+	struct output_capture *capture = data;
+	os_set_thread_name("shaderfilter: output capture");
+	struct dstr path = {0};
+	bool warned = false;
+
+	while (os_sem_wait(capture->sem) == 0) {
+		pthread_mutex_lock(&capture->mutex);
+		if (!capture->queue_count) {
+			const bool stop = capture->stop;
+			pthread_mutex_unlock(&capture->mutex);
+			if (stop)
+				break;
 			continue;
 		}
-		char *start = texture + texture_diff;
-		while (*start == ' ' || *start == '\t')
-			start++;
-		char *end = start;
-		while (*end != ' ' && *end != '\t' && *end != ',' && *end != ')' && *end != '\n' && *end != 0)
-			end++;
-		dstr_copy(&texture_name, "");
-		dstr_ncat(&texture_name, start, end - start);
-
-		dstr_copy(&replacing, "");
-		dstr_ncat(&replacing, texture, end - texture);
-
-		dstr_copy(&replacement, "");
-
-		if (num_textures) {
-			dstr_cat_dstr(&replacement, &texture_name);
-			dstr_cat(&replacement, ".Sample(textureSampler");
-
-			dstr_cat(&insert_text, "uniform texture2d ");
-			dstr_cat(&insert_text, texture_name.array);
-			dstr_cat(&insert_text, ";\n");
+		struct capture_frame frame = capture->queue[capture->queue_head];
+		capture->queue_head = (capture->queue_head + 1) % CAPTURE_QUEUE;
+		capture->queue_count--;
+		pthread_mutex_unlock(&capture->mutex);
+
+		bool success;
+		if (capture->png) {
+			dstr_printf(&path, "%s_%06llu.png", capture->prefix, (unsigned long long)frame.index);
+			success = write_png(path.array, frame.data, frame.cx, frame.cy);
 		} else {
-			dstr_cat(&replacement, "image.Sample(textureSampler");
-		}
-		dstr_replace(&effect_text, replacing.array, replacement.array);
-
-		dstr_copy(&replacing, "textureSize(");
-		dstr_cat(&replacing, texture_name.array);
-		dstr_cat(&replacing, ", 0)");
-
-		dstr_replace(&effect_text, replacing.array, "uv_size");
-		dstr_replace(&replacing, ", 0)", ",0)");
-		dstr_replace(&effect_text, replacing.array, "uv_size");
-
-		num_textures++;
-		size_t prev_diff = texture_diff;
-		texture = NULL;
-		for (size_t i = 0; i < sizeof(texture_find) / sizeof(char *); i++) {
-			char *t = strstr(effect_text.array + diff + prev_diff, texture_find[i]);
-			if (t && (!texture || t < texture)) {
-				texture = t;
-				texture_diff = strlen(texture_find[i]);
-			}
+			dstr_printf(&path, "%s_%06llu_%ux%u.rgba", capture->prefix, (unsigned long long)frame.index, frame.cx,
+				    frame.cy);
+			success = write_raw(path.array, frame.data, frame.cx, frame.cy);
+		}
+		bfree(frame.data);
+		if (success) {
+			os_atomic_inc_long(&capture->captured);
+		} else {
+			os_atomic_inc_long(&capture->dropped);
+			if (!warned)
+				blog(LOG_WARNING, "[obs-shaderfilter] Unable to write capture %s", path.array);
+			warned = true;
 		}
 	}
-	dstr_free(&replacing);
-	dstr_free(&replacement);
-	dstr_free(&texture_name);
+	dstr_free(&path);
+	return NULL;
+}
 
-	if (insert_text.len > 24) {
-		dstr_insert_dstr(&effect_text, 0, &insert_text);
+static struct output_capture *output_capture_create(const char *directory, const char *name, bool png, long interval)
+{
+	struct output_capture *capture = bzalloc(sizeof(struct output_capture));
+	capture->interval = interval > 0 ? interval : 1;
+	capture->png = png;
+
+	// File names start with the filter name, without characters that are not valid in paths.
+	struct dstr prefix = {0};
+	dstr_printf(&prefix, "%s/%s", directory, name);
+	for (char *c = prefix.array + strlen(directory) + 1; *c; c++) {
+		if (strchr("/\\:*?\"<>|", *c))
+			*c = '_';
 	}
-	dstr_free(&insert_text);
-
-	obs_data_set_string(settings, "shader_text", effect_text.array);
+	capture->prefix = prefix.array;
 
-	dstr_free(&effect_text);
+	pthread_mutex_init(&capture->mutex, NULL);
+	os_sem_init(&capture->sem, 0);
+	capture->thread_created = pthread_create(&capture->thread, NULL, output_capture_thread, capture) == 0;
+	return capture;
+}
 
-	obs_data_release(settings);
-	obs_property_set_visible(property, false);
+static void output_capture_destroy(struct output_capture *capture)
+{
+	if (!capture)
+		return;
+	pthread_mutex_lock(&capture->mutex);
+	capture->stop = true;
+	pthread_mutex_unlock(&capture->mutex);
+	os_sem_post(capture->sem);
+	if (capture->thread_created)
+		pthread_join(capture->thread, NULL);
 
-	filter->reload_effect = true;
+	obs_enter_graphics();
+	for (size_t i = 0; i < CAPTURE_RING; i++)
+		gs_stagesurface_destroy(capture->surfaces[i]);
+	obs_leave_graphics();
 
-	obs_source_update(filter->context, NULL);
-	return true;
+	// Frames still queued when the capture stops are written before the thread exits, except when it never started.
+	for (size_t i = 0; i < capture->queue_count; i++)
+		bfree(capture->queue[(capture->queue_head + i) % CAPTURE_QUEUE].data);
+	blog(LOG_INFO, "[obs-shaderfilter] Output capture to %s finished: %ld frames written, %ld dropped", capture->prefix,
+	     capture->captured, capture->dropped);
+	os_sem_destroy(capture->sem);
+	pthread_mutex_destroy(&capture->mutex);
+	bfree(capture->prefix);
+	bfree(capture);
 }
 
-static const char *shader_filter_texture_file_filter = "Textures (*.bmp *.tga *.png *.jpeg *.jpg *.gif);;";
+// Graphics thread. Hands a staged frame to the worker.
+static void output_capture_read(struct output_capture *capture, size_t slot)
+{
+	if (!capture->staged[slot])
+		return;
+	capture->staged[slot] = false;
+
+	gs_stagesurf_t *surface = capture->surfaces[slot];
+	uint8_t *data;
+	uint32_t linesize;
+	struct capture_frame frame = {0};
+	if (gs_stagesurface_map(surface, &data, &linesize)) {
+		const size_t row = (size_t)capture->cx * 4;
+		frame.data = bmalloc(row * capture->cy);
+		frame.cx = capture->cx;
+		frame.cy = capture->cy;
+		frame.index = capture->staged_index[slot];
+		for (uint32_t y = 0; y < capture->cy; y++)
+			memcpy(frame.data + y * row, data + (size_t)y * linesize, row);
+		gs_stagesurface_unmap(surface);
+	}
 
-#define MIN_AUDIO_THRESHOLD -60.0f
+	bool queued = false;
+	pthread_mutex_lock(&capture->mutex);
+	while (frame.data && capture->lossless && capture->queue_count == CAPTURE_QUEUE && capture->thread_created) {
+		pthread_mutex_unlock(&capture->mutex);
+		os_sleep_ms(1);
+		pthread_mutex_lock(&capture->mutex);
+	}
+	if (frame.data && capture->queue_count < CAPTURE_QUEUE) {
+		capture->queue[(capture->queue_head + capture->queue_count) % CAPTURE_QUEUE] = frame;
+		capture->queue_count++;
+		queued = true;
+	}
+	pthread_mutex_unlock(&capture->mutex);
+	if (queued) {
+		os_sem_post(capture->sem);
+	} else {
+		bfree(frame.data);
+		os_atomic_inc_long(&capture->dropped);
+	}
+}
 
-static float convert_db_to_linear(float db_value)
+// Graphics thread. Reads back every frame that is still staged, oldest first.
+static void output_capture_flush(struct output_capture *capture)
 {
-	if (db_value <= MIN_AUDIO_THRESHOLD || db_value > 0.0f)
-		return 0.0f;
-
-	return fmaxf(0.0f, fminf(1.0f, (db_value - MIN_AUDIO_THRESHOLD) / (-MIN_AUDIO_THRESHOLD)));
+	for (size_t i = 0; i < CAPTURE_RING; i++)
+		output_capture_read(capture, (capture->next + i) % CAPTURE_RING);
 }
 
-static void shader_filter_audio_callback(void *data, const float magnitude[MAX_AUDIO_CHANNELS],
-					 const float peak[MAX_AUDIO_CHANNELS], const float input_peak[MAX_AUDIO_CHANNELS])
+// Graphics thread, once per rendered frame after the output texture is complete.
+static void output_capture_frame(struct shader_filter_data *filter)
 {
-	UNUSED_PARAMETER(input_peak);
-	struct shader_filter_data *filter = (struct shader_filter_data *)data;
+	struct output_capture *capture = filter->capture;
+	gs_texture_t *texture = capture ? gs_texrender_get_texture(filter->output_texrender) : NULL;
+	if (!texture)
+		return;
 
-	float max_peak = MIN_AUDIO_THRESHOLD;
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-		if (peak[i] > max_peak && peak[i] != 0.0f) {
-			max_peak = peak[i];
+	const uint32_t cx = gs_texture_get_width(texture);
+	const uint32_t cy = gs_texture_get_height(texture);
+	if (cx != capture->cx || cy != capture->cy) {
+		output_capture_flush(capture);
+		for (size_t i = 0; i < CAPTURE_RING; i++) {
+			gs_stagesurface_destroy(capture->surfaces[i]);
+			capture->surfaces[i] = gs_stagesurface_create(cx, cy, GS_RGBA);
 		}
+		capture->cx = cx;
+		capture->cy = cy;
 	}
 
-	float max_magnitude = MIN_AUDIO_THRESHOLD;
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-		if (magnitude[i] > max_magnitude && magnitude[i] != 0.0f) {
-			max_magnitude = magnitude[i];
-		}
-	}
+	// The slot about to be reused was staged CAPTURE_RING frames ago.
+	const size_t slot = capture->next;
+	gs_stagesurf_t *surface = capture->surfaces[slot];
+	output_capture_read(capture, slot);
 
-	filter->current_audio_peak = convert_db_to_linear(max_peak);
-	filter->current_audio_magnitude = convert_db_to_linear(max_magnitude);
+	if (surface && capture->frame_count % (uint64_t)os_atomic_load_long(&capture->interval) == 0) {
+		gs_stage_texture(surface, texture);
+		capture->staged[slot] = true;
+		capture->staged_index[slot] = capture->frame_count;
+	}
+	capture->frame_count++;
+	capture->next = (slot + 1) % CAPTURE_RING;
 }
 
-static bool shader_filter_enum_audio_sources(void *data, obs_source_t *source)
+static void shader_filter_update_capture(struct shader_filter_data *filter, obs_data_t *settings)
 {
-	obs_property_t *prop = (obs_property_t *)data;
-	uint32_t flags = obs_source_get_output_flags(source);
-
-	if ((flags & OBS_SOURCE_AUDIO) != 0) {
-		const char *name = obs_source_get_name(source);
-		obs_property_list_add_string(prop, name, name);
+	const char *directory = obs_data_get_string(settings, "capture_path");
+	const bool enabled = !filter->transition && obs_data_get_bool(settings, "capture_output") && *directory;
+	const bool png = strcmp(obs_data_get_string(settings, "capture_format"), "raw") != 0;
+	const long interval = (long)obs_data_get_int(settings, "capture_interval");
+
+	struct output_capture *capture = filter->capture;
+	if (enabled && capture && capture->png == png &&
+	    strncmp(capture->prefix, directory, strlen(directory)) == 0 && capture->prefix[strlen(directory)] == '/') {
+		os_atomic_set_long(&capture->interval, interval > 0 ? interval : 1);
+		return;
 	}
+	if (!enabled && !capture)
+		return;
 
-	return true;
+	struct output_capture *replacement =
+		enabled ? output_capture_create(directory, obs_source_get_name(filter->context), png, interval) : NULL;
+	obs_enter_graphics();
+	filter->capture = replacement;
+	obs_leave_graphics();
+	output_capture_destroy(capture);
 }
 
-static obs_properties_t *shader_filter_properties(void *data)
+// Optional GPU timing of the filter's own passes. Queries rotate through GPU_TIMER_FRAMES sets so results are read a
+// couple of frames later without stalling, and the last GPU_TIMER_SAMPLES frames are kept per phase. Timer ranges can
+// not nest, so a filter rendered while another one is being timed (e.g. as a texture source of it) skips that frame.
+static const char *gpu_timer_phase_names[GPU_TIMER_PHASES] = {"shader", "output"};
+static bool gpu_timer_range_open = false;
+
+static struct gpu_timer *gpu_timer_create(void)
 {
-	struct shader_filter_data *filter = data;
+	struct gpu_timer *timer = bzalloc(sizeof(struct gpu_timer));
+	pthread_mutex_init(&timer->mutex, NULL);
+	timer->last_log = os_gettime_ns();
+	for (size_t i = 0; i < GPU_TIMER_FRAMES; i++) {
+		timer->ranges[i] = gs_timer_range_create();
+		for (size_t p = 0; p < GPU_TIMER_PHASES; p++)
+			timer->timers[i][p] = gs_timer_create();
+	}
+	return timer;
+}
 
-	struct dstr examples_path = {0};
-	dstr_init(&examples_path);
-	dstr_cat(&examples_path, obs_get_module_data_path(obs_current_module()));
-	dstr_cat(&examples_path, "/examples");
+static void gpu_timer_destroy(struct gpu_timer *timer)
+{
+	if (!timer)
+		return;
+	obs_enter_graphics();
+	for (size_t i = 0; i < GPU_TIMER_FRAMES; i++) {
+		gs_timer_range_destroy(timer->ranges[i]);
+		for (size_t p = 0; p < GPU_TIMER_PHASES; p++)
+			gs_timer_destroy(timer->timers[i][p]);
+	}
+	obs_leave_graphics();
+	pthread_mutex_destroy(&timer->mutex);
+	bfree(timer);
+}
 
-	obs_properties_t *props = obs_properties_create();
-	obs_properties_set_param(props, filter, NULL);
+static void gpu_timer_collect(struct gpu_timer *timer, size_t frame)
+{
+	bool disjoint = true;
+	uint64_t frequency = 0;
+	if (!gs_timer_range_get_data(timer->ranges[frame], &disjoint, &frequency) || disjoint || !frequency)
+		return;
 
-	if (!filter || !filter->transition) {
-		obs_properties_add_int(props, "expand_left", obs_module_text("ShaderFilter.ExpandLeft"), 0, 9999, 1);
-		obs_properties_add_int(props, "expand_right", obs_module_text("ShaderFilter.ExpandRight"), 0, 9999, 1);
-		obs_properties_add_int(props, "expand_top", obs_module_text("ShaderFilter.ExpandTop"), 0, 9999, 1);
-		obs_properties_add_int(props, "expand_bottom", obs_module_text("ShaderFilter.ExpandBottom"), 0, 9999, 1);
+	pthread_mutex_lock(&timer->mutex);
+	for (size_t p = 0; p < GPU_TIMER_PHASES; p++) {
+		uint64_t ticks;
+		if (!timer->used[frame][p] || !gs_timer_get_data(timer->timers[frame][p], &ticks))
+			continue;
+		timer->samples[p][timer->sample_pos[p]] = (float)((double)ticks * 1000.0 / (double)frequency);
+		timer->sample_pos[p] = (timer->sample_pos[p] + 1) % GPU_TIMER_SAMPLES;
+		if (timer->sample_count[p] < GPU_TIMER_SAMPLES)
+			timer->sample_count[p]++;
 	}
+	pthread_mutex_unlock(&timer->mutex);
+}
 
-	obs_properties_add_bool(props, "override_entire_effect", obs_module_text("ShaderFilter.OverrideEntireEffect"));
+static void gpu_timer_begin_frame(struct shader_filter_data *filter)
+{
+	if (!filter->gpu_timing || gpu_timer_range_open)
+		return;
+	if (!filter->gpu_timer)
+		filter->gpu_timer = gpu_timer_create();
+
+	struct gpu_timer *timer = filter->gpu_timer;
+	timer->frame = (timer->frame + 1) % GPU_TIMER_FRAMES;
+	if (timer->pending[timer->frame])
+		gpu_timer_collect(timer, timer->frame);
+	memset(timer->used[timer->frame], 0, sizeof(timer->used[timer->frame]));
+	gs_timer_range_begin(timer->ranges[timer->frame]);
+	timer->active = true;
+	gpu_timer_range_open = true;
+}
 
-	obs_property_t *from_file = obs_properties_add_bool(props, "from_file", obs_module_text("ShaderFilter.LoadFromFile"));
-	obs_property_set_modified_callback(from_file, shader_filter_from_file_changed);
+static void gpu_timer_end_frame(struct shader_filter_data *filter)
+{
+	struct gpu_timer *timer = filter->gpu_timer;
+	if (!timer || !timer->active)
+		return;
+	gs_timer_range_end(timer->ranges[timer->frame]);
+	timer->pending[timer->frame] = true;
+	timer->active = false;
+	gpu_timer_range_open = false;
+}
 
-	obs_property_t *shader_text =
-		obs_properties_add_text(props, "shader_text", obs_module_text("ShaderFilter.ShaderText"), OBS_TEXT_MULTILINE);
-	obs_property_set_modified_callback(shader_text, shader_filter_text_changed);
+static void gpu_timer_begin(struct shader_filter_data *filter, enum gpu_timer_phase phase)
+{
+	struct gpu_timer *timer = filter->gpu_timer;
+	if (timer && timer->active)
+		gs_timer_begin(timer->timers[timer->frame][phase]);
+}
 
-	obs_properties_add_button2(props, "shader_convert", obs_module_text("ShaderFilter.Convert"), shader_filter_convert, data);
+static void gpu_timer_end(struct shader_filter_data *filter, enum gpu_timer_phase phase)
+{
+	struct gpu_timer *timer = filter->gpu_timer;
+	if (!timer || !timer->active)
+		return;
+	gs_timer_end(timer->timers[timer->frame][phase]);
+	timer->used[timer->frame][phase] = true;
+}
 
-	char *abs_path = os_get_abs_path_ptr(examples_path.array);
-	obs_property_t *file_name = obs_properties_add_path(props, "shader_file_name",
-							    obs_module_text("ShaderFilter.ShaderFileName"), OBS_PATH_FILE, NULL,
-							    abs_path ? abs_path : examples_path.array);
-	if (abs_path)
-		bfree(abs_path);
-	dstr_free(&examples_path);
-	obs_property_set_modified_callback(file_name, shader_filter_file_name_changed);
+static int gpu_timer_compare_sample(const void *a, const void *b)
+{
+	const float x = *(const float *)a;
+	const float y = *(const float *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
 
-	if (filter) {
-		obs_data_t *settings = obs_source_get_settings(filter->context);
-		const char *last_error = obs_data_get_string(settings, "last_error");
-		if (last_error && strlen(last_error)) {
-			obs_property_t *error =
-				obs_properties_add_text(props, "last_error", obs_module_text("ShaderFilter.Error"), OBS_TEXT_INFO);
-			obs_property_text_set_info_type(error, OBS_TEXT_INFO_ERROR);
-		}
-		obs_data_release(settings);
+// One line per measured phase with the average, 95th percentile and maximum in milliseconds.
+static void gpu_timer_summary(struct gpu_timer *timer, struct dstr *text)
+{
+	if (!timer)
+		return;
+	pthread_mutex_lock(&timer->mutex);
+	for (size_t p = 0; p < GPU_TIMER_PHASES; p++) {
+		const size_t count = timer->sample_count[p];
+		if (!count)
+			continue;
+		float sorted[GPU_TIMER_SAMPLES];
+		memcpy(sorted, timer->samples[p], sizeof(float) * count);
+		qsort(sorted, count, sizeof(float), gpu_timer_compare_sample);
+		float sum = 0.0f;
+		for (size_t i = 0; i < count; i++)
+			sum += sorted[i];
+		if (text->len)
+			dstr_cat(text, "\n");
+		dstr_catf(text, "%s: avg %.3f ms, p95 %.3f ms, max %.3f ms", gpu_timer_phase_names[p], sum / (float)count,
+			  sorted[(count * 95) / 100 < count ? (count * 95) / 100 : count - 1], sorted[count - 1]);
 	}
+	pthread_mutex_unlock(&timer->mutex);
+}
 
-	obs_properties_add_button(props, "reload_effect", obs_module_text("ShaderFilter.ReloadEffect"),
-				  shader_filter_reload_effect_clicked);
-
-	if (filter && (filter->param_audio_magnitude || filter->param_audio_peak)) {
-		obs_property_t *audio_source = obs_properties_add_list(props, "audio_source", "Audio source", OBS_COMBO_TYPE_LIST,
-								       OBS_COMBO_FORMAT_STRING);
-		obs_property_list_add_string(audio_source, "None", "");
+// Logs a summary every minute. The properties only show a snapshot, refreshed with the button next to it, so the
+// dialog is not rebuilt while it is being edited.
+static void gpu_timer_tick(struct shader_filter_data *filter)
+{
+	struct gpu_timer *timer = filter->gpu_timer;
+	if (!filter->gpu_timing || !timer)
+		return;
+	const uint64_t now = os_gettime_ns();
+	if (now - timer->last_log < GPU_TIMER_LOG_INTERVAL_NS)
+		return;
+	timer->last_log = now;
 
-		obs_enum_sources(shader_filter_enum_audio_sources, audio_source);
+	struct dstr text = {0};
+	gpu_timer_summary(timer, &text);
+	if (text.len) {
+		dstr_replace(&text, "\n", "; ");
+		blog(LOG_INFO, "[obs-shaderfilter] GPU time of '%s': %s", obs_source_get_name(filter->context), text.array);
+	}
+	dstr_free(&text);
+}
+
+static void shader_filter_free_fuse(struct shader_filter_data *filter)
+{
+	struct shader_filter_data *fuse = filter->fuse;
+	if (fuse) {
+		// Sources and images are borrowed from the stages, only the fused effect's own state is freed.
+		for (size_t i = 0; i < fuse->stored_param_list.num; i++) {
+			fuse->stored_param_list.array[i].source = NULL;
+			fuse->stored_param_list.array[i].image = NULL;
+			fuse->stored_param_list.array[i].sequence = NULL;
+		}
+		shader_filter_clear_params(fuse);
+		da_free(fuse->stored_param_list);
+		if (fuse->effect) {
+			obs_enter_graphics();
+			gs_effect_destroy(fuse->effect);
+			obs_leave_graphics();
+		}
+		bfree(fuse);
+		filter->fuse = NULL;
+	}
+	da_free(filter->fuse_bindings);
+	for (size_t i = 0; i < filter->fuse_sources.num; i++)
+		obs_source_release(filter->fuse_sources.array[i]);
+	da_free(filter->fuse_sources);
+	for (size_t i = 0; i < filter->fuse_stage_builtins.num; i++)
+		bfree(filter->fuse_stage_builtins.array[i]);
+	da_free(filter->fuse_stage_builtins);
+	filter->fuse_active = false;
+	filter->fuse_signature = 0;
+}
+
+static void shader_filter_destroy(void *data)
+{
+	struct shader_filter_data *filter = data;
+	filter_registry_remove(filter);
+	obs_data_release(filter->stats_snapshot);
+	input_stream_open(filter, NULL, true);
+	input_stream_open(filter, NULL, false);
+	shader_filter_clear_params(filter);
+	free_image_stats(filter);
+	shader_filter_free_fuse(filter);
+
+	obs_enter_graphics();
+	if (filter->effect)
+		gs_effect_destroy(filter->effect);
+	if (filter->output_effect)
+		gs_effect_destroy(filter->output_effect);
+	if (filter->input_texrender)
+		gs_texrender_destroy(filter->input_texrender);
+	if (filter->output_texrender)
+		gs_texrender_destroy(filter->output_texrender);
+	if (filter->previous_input_texrender)
+		gs_texrender_destroy(filter->previous_input_texrender);
+	for (size_t i = 0; i < IMAGE_HISTORY_MAX; i++)
+		gs_texrender_destroy(filter->history[i]);
+	if (filter->previous_output_texrender)
+		gs_texrender_destroy(filter->previous_output_texrender);
+	for (size_t i = 0; i < filter->output_tiles.num; i++)
+		gs_texrender_destroy(filter->output_tiles.array[i]);
+	if (filter->sprite_buffer)
+		gs_vertexbuffer_destroy(filter->sprite_buffer);
+	obs_leave_graphics();
+
+	dstr_free(&filter->last_path);
+	dstr_free(&filter->shader_id);
+	da_free(filter->stored_param_list);
+	da_free(filter->lerp_pairs);
+	da_free(filter->output_tiles);
+
+	shader_filter_detach_audio_capture(filter);
+	audio_spectrum_destroy(filter->audio_spectrum);
+	bfree(filter->audio_mono);
+	gpu_timer_destroy(filter->gpu_timer);
+	output_capture_destroy(filter->capture);
+	if (filter->audio_source_name)
+		bfree(filter->audio_source_name);
+
+	bfree(filter);
+}
+
+static bool shader_filter_from_file_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(p);
+	struct shader_filter_data *filter = obs_properties_get_param(props);
+
+	bool from_file = obs_data_get_bool(settings, "from_file");
+
+	obs_property_set_visible(obs_properties_get(props, "shader_text"), !from_file);
+	obs_property_set_visible(obs_properties_get(props, "shader_file_name"), from_file);
+
+	if (from_file != filter->last_from_file) {
+		filter->reload_effect = true;
+	}
+	filter->last_from_file = from_file;
+
+	return true;
+}
+
+static bool shader_filter_text_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(p);
+	struct shader_filter_data *filter = obs_properties_get_param(props);
+	if (!filter)
+		return false;
+
+	const char *shader_text = obs_data_get_string(settings, "shader_text");
+	bool can_convert = strstr(shader_text, "void mainImage( out vec4") || strstr(shader_text, "void mainImage(out vec4") ||
+			   strstr(shader_text, "void main()") || strstr(shader_text, "vec4 effect(vec4");
+	obs_property_t *shader_convert = obs_properties_get(props, "shader_convert");
+	bool visible = obs_property_visible(obs_properties_get(props, "shader_text"));
+	if (obs_property_visible(shader_convert) != (can_convert && visible)) {
+		obs_property_set_visible(shader_convert, can_convert && visible);
+		return true;
+	}
+	return false;
+}
+
+static bool shader_filter_file_name_changed(obs_properties_t *props, obs_property_t *p, obs_data_t *settings)
+{
+	struct shader_filter_data *filter = obs_properties_get_param(props);
+	const char *new_file_name = obs_data_get_string(settings, obs_property_name(p));
+
+	if ((dstr_is_empty(&filter->last_path) && strlen(new_file_name)) ||
+	    (filter->last_path.array && dstr_cmp(&filter->last_path, new_file_name) != 0)) {
+		filter->reload_effect = true;
+		dstr_copy(&filter->last_path, new_file_name);
+		size_t l = strlen(new_file_name);
+		if (l > 7 && strncmp(new_file_name + l - 7, ".effect", 7) == 0) {
+			obs_data_set_bool(settings, "override_entire_effect", true);
+		} else if (l > 7 && strncmp(new_file_name + l - 7, ".shader", 7) == 0) {
+			obs_data_set_bool(settings, "override_entire_effect", false);
+		}
+	}
+
+	return false;
+}
+
+static bool shader_filter_reload_effect_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+	struct shader_filter_data *filter = data;
+
+	filter->reload_effect = true;
+
+	obs_source_update(filter->context, NULL);
+
+	return false;
+}
+
+// Rebuilds the properties so the GPU time and capture status snapshots are current.
+static bool shader_filter_refresh_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+	UNUSED_PARAMETER(data);
+	return true;
+}
+
+static bool add_source_to_list(void *data, obs_source_t *source)
+{
+	obs_property_t *p = data;
+	const char *name = obs_source_get_name(source);
+	size_t count = obs_property_list_item_count(p);
+	size_t idx = 0;
+	while (idx < count && strcmp(name, obs_property_list_item_string(p, idx)) > 0)
+		idx++;
+	obs_property_list_insert_string(p, idx, name, name);
+	return true;
+}
+
+static bool shader_filter_convert(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	UNUSED_PARAMETER(props);
+	if (!data)
+		return false;
+	struct shader_filter_data *filter = data;
+	obs_data_t *settings = obs_source_get_settings(filter->context);
+	if (!settings)
+		return false;
+	struct dstr effect_text = {0};
+	dstr_init_copy(&effect_text, obs_data_get_string(settings, "shader_text"));
+	if (!convert_shader_text(&effect_text)) {
+		dstr_free(&effect_text);
+		obs_data_release(settings);
+		return false;
+	}
+
+	obs_data_set_string(settings, "shader_text", effect_text.array);
+
+	dstr_free(&effect_text);
+
+	obs_data_release(settings);
+	obs_property_set_visible(property, false);
+
+	filter->reload_effect = true;
+
+	obs_source_update(filter->context, NULL);
+	return true;
+}
+
+static const char *shader_filter_texture_file_filter = "Textures (*.bmp *.tga *.png *.jpeg *.jpg *.gif);;";
+
+static bool shader_filter_enum_audio_sources(void *data, obs_source_t *source)
+{
+	obs_property_t *prop = (obs_property_t *)data;
+	uint32_t flags = obs_source_get_output_flags(source);
+
+	if ((flags & OBS_SOURCE_AUDIO) != 0) {
+		const char *name = obs_source_get_name(source);
+		obs_property_list_add_string(prop, name, name);
+	}
+
+	return true;
+}
+
+static obs_properties_t *shader_filter_properties(void *data)
+{
+	struct shader_filter_data *filter = data;
+
+	struct dstr examples_path = {0};
+	dstr_init(&examples_path);
+	dstr_cat(&examples_path, obs_get_module_data_path(obs_current_module()));
+	dstr_cat(&examples_path, "/examples");
+
+	obs_properties_t *props = obs_properties_create();
+	obs_properties_set_param(props, filter, NULL);
+
+	if (!filter || !filter->transition) {
+		obs_properties_add_int(props, "expand_left", obs_module_text("ShaderFilter.ExpandLeft"), 0, 9999, 1);
+		obs_properties_add_int(props, "expand_right", obs_module_text("ShaderFilter.ExpandRight"), 0, 9999, 1);
+		obs_properties_add_int(props, "expand_top", obs_module_text("ShaderFilter.ExpandTop"), 0, 9999, 1);
+		obs_properties_add_int(props, "expand_bottom", obs_module_text("ShaderFilter.ExpandBottom"), 0, 9999, 1);
+		obs_properties_add_int(props, "tile_size", obs_module_text("ShaderFilter.TileSize"), 0, 16384, 256);
+		obs_properties_add_bool(props, "fuse_filters", obs_module_text("ShaderFilter.FuseFilters"));
+	}
+
+	obs_properties_add_bool(props, "override_entire_effect", obs_module_text("ShaderFilter.OverrideEntireEffect"));
+	obs_properties_add_bool(props, "predecode_images", obs_module_text("ShaderFilter.PredecodeImages"));
+
+	obs_property_t *from_file = obs_properties_add_bool(props, "from_file", obs_module_text("ShaderFilter.LoadFromFile"));
+	obs_property_set_modified_callback(from_file, shader_filter_from_file_changed);
+
+	obs_property_t *shader_text =
+		obs_properties_add_text(props, "shader_text", obs_module_text("ShaderFilter.ShaderText"), OBS_TEXT_MULTILINE);
+	obs_property_set_modified_callback(shader_text, shader_filter_text_changed);
+
+	obs_properties_add_button2(props, "shader_convert", obs_module_text("ShaderFilter.Convert"), shader_filter_convert, data);
+
+	char *abs_path = os_get_abs_path_ptr(examples_path.array);
+	obs_property_t *file_name = obs_properties_add_path(props, "shader_file_name",
+							    obs_module_text("ShaderFilter.ShaderFileName"), OBS_PATH_FILE, NULL,
+							    abs_path ? abs_path : examples_path.array);
+	if (abs_path)
+		bfree(abs_path);
+	dstr_free(&examples_path);
+	obs_property_set_modified_callback(file_name, shader_filter_file_name_changed);
+
+	if (filter) {
+		obs_data_t *settings = obs_source_get_settings(filter->context);
+		const char *last_error = obs_data_get_string(settings, "last_error");
+		if (last_error && strlen(last_error)) {
+			obs_property_t *error =
+				obs_properties_add_text(props, "last_error", obs_module_text("ShaderFilter.Error"), OBS_TEXT_INFO);
+			obs_property_text_set_info_type(error, OBS_TEXT_INFO_ERROR);
+		}
+		obs_data_release(settings);
+	}
+
+	obs_properties_add_button(props, "reload_effect", obs_module_text("ShaderFilter.ReloadEffect"),
+				  shader_filter_reload_effect_clicked);
+
+	obs_properties_add_bool(props, "gpu_timing", obs_module_text("ShaderFilter.GpuTiming"));
+	if (filter && filter->gpu_timing && filter->gpu_timer) {
+		struct dstr text = {0};
+		gpu_timer_summary(filter->gpu_timer, &text);
+		dstr_insert(&text, 0, text.len ? ":\n" : ": -");
+		dstr_insert(&text, 0, obs_module_text("ShaderFilter.GpuTime"));
+		obs_properties_add_text(props, "gpu_time", text.array, OBS_TEXT_INFO);
+		dstr_free(&text);
+		obs_properties_add_button(props, "gpu_time_refresh", obs_module_text("ShaderFilter.GpuTimeRefresh"),
+					  shader_filter_refresh_clicked);
+	}
+
+	if (!filter || !filter->transition) {
+		obs_properties_t *capture = obs_properties_create();
+		obs_properties_add_path(capture, "capture_path", obs_module_text("ShaderFilter.CapturePath"), OBS_PATH_DIRECTORY,
+					NULL, NULL);
+		obs_property_t *format = obs_properties_add_list(capture, "capture_format", obs_module_text("ShaderFilter.CaptureFormat"),
+								 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+		obs_property_list_add_string(format, "PNG", "png");
+		obs_property_list_add_string(format, obs_module_text("ShaderFilter.CaptureRaw"), "raw");
+		obs_properties_add_int(capture, "capture_interval", obs_module_text("ShaderFilter.CaptureInterval"), 1, 3600, 1);
+		if (filter && filter->capture) {
+			struct dstr text = {0};
+			dstr_printf(&text, obs_module_text("ShaderFilter.CaptureStatusFormat"),
+				    os_atomic_load_long(&filter->capture->captured), os_atomic_load_long(&filter->capture->dropped));
+			dstr_insert(&text, 0, ": ");
+			dstr_insert(&text, 0, obs_module_text("ShaderFilter.CaptureStatus"));
+			obs_properties_add_text(capture, "capture_status", text.array, OBS_TEXT_INFO);
+			dstr_free(&text);
+			obs_properties_add_button(capture, "capture_status_refresh",
+						  obs_module_text("ShaderFilter.CaptureStatusRefresh"), shader_filter_refresh_clicked);
+		}
+		obs_properties_add_group(props, "capture_output", obs_module_text("ShaderFilter.CaptureOutput"),
+					 OBS_GROUP_CHECKABLE, capture);
+	}
+
+	if (filter && (filter->param_audio_magnitude || filter->param_audio_peak || filter->param_audio_spectrum ||
+		       os_atomic_load_bool(&filter->audio_beats))) {
+		obs_property_t *audio_source = obs_properties_add_list(props, "audio_source", "Audio source", OBS_COMBO_TYPE_LIST,
+								       OBS_COMBO_FORMAT_STRING);
+		obs_property_list_add_string(audio_source, "None", "");
+
+		obs_enum_sources(shader_filter_enum_audio_sources, audio_source);
+	}
+
+	if (filter && (filter->param_audio_magnitude || filter->param_audio_peak || os_atomic_load_bool(&filter->audio_beats))) {
+		obs_property_t *p = obs_properties_add_int_slider(props, "audio_attack", obs_module_text("ShaderFilter.AudioAttack"),
+								  0, 2000, 1);
+		obs_property_int_set_suffix(p, " ms");
+		p = obs_properties_add_int_slider(props, "audio_release", obs_module_text("ShaderFilter.AudioRelease"), 0, 2000, 1);
+		obs_property_int_set_suffix(p, " ms");
+	}
+
+	if (filter && filter->param_audio_spectrum) {
+		obs_property_t *fft_size = obs_properties_add_list(props, "audio_fft_size", obs_module_text("ShaderFilter.FftSize"),
+								   OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+		for (long long size = 256; size <= 8192; size *= 2) {
+			char name[16];
+			snprintf(name, sizeof(name), "%lld", size);
+			obs_property_list_add_int(fft_size, name, size);
+		}
+		obs_properties_add_int(props, "audio_spectrum_bands", obs_module_text("ShaderFilter.SpectrumBands"), 8, 512, 1);
+		obs_properties_add_bool(props, "audio_spectrum_log", obs_module_text("ShaderFilter.SpectrumLog"));
 	}
 
 	DARRAY(obs_property_t *) groups;
@@ -2417,6 +3941,16 @@ static obs_properties_t *shader_filter_properties(void *data)
 			} else if (widget_type != NULL && strcmp(widget_type, "file") == 0) {
 				obs_properties_add_path(group, param_name, display_name.array, OBS_PATH_FILE,
 							shader_filter_texture_file_filter, NULL);
+			} else if (widget_type != NULL && strcmp(widget_type, "sequence") == 0) {
+				// Any frame of a numbered sequence selects the whole sequence.
+				obs_properties_add_path(group, param_name, display_name.array, OBS_PATH_FILE,
+							shader_filter_texture_file_filter, NULL);
+				dstr_printf(&sources_name, "%s_fps", param_name);
+				obs_properties_add_float(group, sources_name.array, obs_module_text("ShaderFilter.SequenceFps"), 0.1,
+							 240.0, 0.1);
+				dstr_printf(&sources_name, "%s_loop", param_name);
+				obs_properties_add_bool(group, sources_name.array, obs_module_text("ShaderFilter.SequenceLoop"));
+				dstr_free(&sources_name);
 			} else {
 				dstr_init_copy_dstr(&sources_name, &param->name);
 				dstr_cat(&sources_name, "_source");
@@ -2451,27 +3985,183 @@ static obs_properties_t *shader_filter_properties(void *data)
 	return props;
 }
 
-static void shader_filter_update(void *data, obs_data_t *settings)
+static uint64_t texture_vram(gs_texture_t *texture)
 {
-	struct shader_filter_data *filter = data;
+	if (!texture)
+		return 0;
+	return (uint64_t)gs_texture_get_width(texture) * gs_texture_get_height(texture) *
+	       gs_get_format_bpp(gs_texture_get_color_format(texture)) / 8;
+}
 
-	// Get expansions. Will be used in the video_tick() callback.
+static uint64_t texrender_vram(gs_texrender_t *render)
+{
+	return render ? texture_vram(gs_texrender_get_texture(render)) : 0;
+}
 
-	filter->expand_left = (int)obs_data_get_int(settings, "expand_left");
-	filter->expand_right = (int)obs_data_get_int(settings, "expand_right");
-	filter->expand_top = (int)obs_data_get_int(settings, "expand_top");
-	filter->expand_bottom = (int)obs_data_get_int(settings, "expand_bottom");
-	filter->rand_activation_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+static uint64_t image_cache_entry_vram(struct image_cache_entry *entry)
+{
+	if (!entry || !entry->uploaded)
+		return 0;
+	uint64_t vram = texture_vram(entry->image.texture);
+	for (size_t f = 0; entry->frame_textures && f < entry->frame_count; f++)
+		vram += texture_vram(entry->frame_textures[f]);
+	return vram;
+}
+
+// Graphics context held. Everything the filter does not share with other filters.
+static uint64_t shader_filter_owned_vram(struct shader_filter_data *filter)
+{
+	uint64_t vram = texrender_vram(filter->input_texrender) + texrender_vram(filter->output_texrender) +
+			texrender_vram(filter->previous_input_texrender) + texrender_vram(filter->previous_output_texrender);
+	for (size_t i = 0; i < IMAGE_HISTORY_MAX; i++)
+		vram += texrender_vram(filter->history[i]);
+	for (size_t i = 0; i < filter->output_tiles.num; i++)
+		vram += texrender_vram(filter->output_tiles.array[i]);
+	for (size_t i = 0; i < IMAGE_STATS_LEVELS; i++)
+		vram += texrender_vram(filter->stats_levels[i]);
+	vram += texrender_vram(filter->stats_histogram);
+	if (filter->audio_spectrum)
+		vram += texture_vram(filter->audio_spectrum->texture);
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		vram += texrender_vram(param->render);
+		if (param->sequence)
+			vram += texture_vram(param->sequence->texture);
+	}
+	return vram;
+}
+
+// Graphics context held. The images no other filter holds, freed once this filter lets go of them.
+static uint64_t shader_filter_unshared_image_vram(struct shader_filter_data *filter)
+{
+	uint64_t vram = 0;
+	pthread_mutex_lock(&image_cache_mutex);
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct image_cache_entry *image = filter->stored_param_list.array[i].image;
+		if (!image)
+			continue;
+		// Counted once, at its first parameter, against all references this filter holds.
+		long own = 0;
+		bool first = true;
+		for (size_t j = 0; j < filter->stored_param_list.num; j++) {
+			if (filter->stored_param_list.array[j].image != image)
+				continue;
+			first &= j >= i;
+			own++;
+		}
+		// A queued decode holds a reference of its own until the decode thread gets to it.
+		if (first && image->refs - (image->queued ? 1 : 0) == own)
+			vram += image_cache_entry_vram(image);
+	}
+	pthread_mutex_unlock(&image_cache_mutex);
+	return vram;
+}
+
+// Graphics context and filter_registry_mutex held. Counts every texture of every instance, shared images once.
+static uint64_t plugin_vram(void)
+{
+	uint64_t vram = 0;
+	for (size_t i = 0; i < filter_registry.num; i++)
+		vram += shader_filter_owned_vram(filter_registry.array[i]);
+	pthread_mutex_lock(&image_cache_mutex);
+	for (struct image_cache_entry *entry = image_cache; entry; entry = entry->next)
+		vram += image_cache_entry_vram(entry);
+	pthread_mutex_unlock(&image_cache_mutex);
+	return vram;
+}
+
+// Lazy compile: the first compile of a filter whose source is not on screen waits until the filter is shown,
+// activated or rendered. Once loading has settled, the remaining filters are compiled one per idle frame.
+#define LAZY_COMPILE_SETTLE_NS 2000000000ULL
+
+static volatile bool lazy_compile = false;
+static volatile bool lazy_compile_idle = true;
+static uint64_t lazy_compile_idle_after = 0;
+static uint64_t lazy_compile_idle_frame = 0;
+
+// Idle eviction: filters hidden for longer than evict_after_ns release their GPU resources, 0 disables it.
+static uint64_t evict_after_ns = 0;
+static bool evict_effects = false;
+
+// Module-wide VRAM budget, 0 disables it. Checked every VRAM_BUDGET_INTERVAL_NS from the video thread; filters rendered
+// within the last VRAM_BUDGET_IN_USE_NS are never evicted for it.
+#define VRAM_BUDGET_INTERVAL_NS 250000000ULL
+#define VRAM_BUDGET_IN_USE_NS 1000000000ULL
+
+#define VRAM_RELEASE_IMAGES (1 << 0)
+#define VRAM_RELEASE_TEXTURES (1 << 1)
+
+static uint64_t vram_budget = 0;
+static uint64_t vram_budget_checked = 0;
+static bool vram_budget_exceeded = false;
+static volatile long vram_image_evictions = 0;
+static volatile long vram_texture_evictions = 0;
+
+static bool shader_filter_defer_compile(struct shader_filter_data *filter)
+{
+	if (!lazy_compile || filter->transition || filter->compile_requested || filter->effect_generation)
+		return false;
+	// Without a parent (still being created, or a private source) there is nothing to tell when it gets shown.
+	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	if (!parent || obs_source_showing(parent) || obs_source_active(parent))
+		return false;
+	filter->compile_deferred = true;
+	lazy_compile_idle_after = os_gettime_ns() + LAZY_COMPILE_SETTLE_NS;
+	return true;
+}
+
+// Video thread. Allows one deferred compile per frame while rendering leaves at least half of the frame free.
+static bool lazy_compile_claim_idle_frame(void)
+{
+	const uint64_t frame_time = obs_get_video_frame_time();
+	if (!lazy_compile_idle || lazy_compile_idle_frame == frame_time || os_gettime_ns() < lazy_compile_idle_after)
+		return false;
+	if (obs_get_average_frame_time_ns() * 2 > obs_get_frame_interval_ns())
+		return false;
+	lazy_compile_idle_frame = frame_time;
+	return true;
+}
+
+static void shader_filter_update(void *data, obs_data_t *settings)
+{
+	struct shader_filter_data *filter = data;
+	profile_start(update_name);
+	const uint64_t trace_start = trace_begin();
+	const uint64_t update_start = os_gettime_ns();
+
+	// Get expansions. Will be used in the video_tick() callback.
 
-	if (filter->reload_effect) {
+	filter->expand_left = (int)obs_data_get_int(settings, "expand_left");
+	filter->expand_right = (int)obs_data_get_int(settings, "expand_right");
+	filter->expand_top = (int)obs_data_get_int(settings, "expand_top");
+	filter->expand_bottom = (int)obs_data_get_int(settings, "expand_bottom");
+	filter->tile_size = (int)obs_data_get_int(settings, "tile_size");
+	filter->fuse_filters = obs_data_get_bool(settings, "fuse_filters");
+	filter->predecode_images = obs_data_get_bool(settings, "predecode_images");
+	filter->gpu_timing = obs_data_get_bool(settings, "gpu_timing");
+	shader_filter_update_capture(filter, settings);
+	filter->rand_activation_f = shader_filter_random(filter);
+
+	if (filter->reload_effect && !shader_filter_defer_compile(filter)) {
 		filter->reload_effect = false;
 		shader_filter_reload_effect(filter);
 		obs_source_update_properties(filter->context);
 	}
 
-	if (filter->param_audio_magnitude || filter->param_audio_peak) {
+	filter->audio_attack = (float)obs_data_get_int(settings, "audio_attack") / 1000.0f;
+	filter->audio_release = (float)obs_data_get_int(settings, "audio_release") / 1000.0f;
+	const bool audio_beats = filter->param_audio_beat || filter->param_audio_beat_phase || filter->param_audio_bpm ||
+				 filter->param_audio_bass || filter->param_audio_mid || filter->param_audio_treble;
+	os_atomic_set_bool(&filter->audio_beats, audio_beats);
+	if (filter->param_audio_magnitude || filter->param_audio_peak || filter->param_audio_spectrum || audio_beats) {
 		const char *audio_source_name = obs_data_get_string(settings, "audio_source");
-		if (!filter->audio_source_name || strcmp(filter->audio_source_name, audio_source_name) != 0) {
+		if (filter->audio_capture &&
+		    strcmp(filter->audio_source_name ? filter->audio_source_name : "", audio_source_name) == 0) {
+			// Same source as before, only the spectrum settings may have changed.
+			obs_source_t *audio_source = obs_weak_source_get_source(filter->audio_capture);
+			shader_filter_update_audio_capture(filter, settings, audio_source);
+			obs_source_release(audio_source);
+		} else {
 			obs_source_t *audio_source = strlen(audio_source_name) > 0 ? obs_get_source_by_name(audio_source_name) : NULL;
 			if (audio_source && ((obs_source_get_output_flags(audio_source) & OBS_SOURCE_AUDIO) == 0)) {
 				obs_source_release(audio_source);
@@ -2481,6 +4171,9 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				if (filter->audio_source_name)
 					bfree(filter->audio_source_name);
 				filter->audio_source_name = bstrdup(audio_source_name);
+			} else if (filter->audio_source_name) {
+				bfree(filter->audio_source_name);
+				filter->audio_source_name = NULL;
 			}
 
 			if (!audio_source) {
@@ -2490,29 +4183,11 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 					audio_source = NULL;
 				}
 			}
-			if (audio_source) {
-				if (!filter->volmeter) {
-					filter->volmeter = obs_volmeter_create(OBS_FADER_LOG);
-					obs_volmeter_add_callback(filter->volmeter, shader_filter_audio_callback, filter);
-				}
-				obs_volmeter_attach_source(filter->volmeter, audio_source);
-				obs_source_release(audio_source);
-			} else {
-				if (filter->volmeter) {
-					obs_volmeter_destroy(filter->volmeter);
-					filter->volmeter = NULL;
-				}
-				if (filter->audio_source_name) {
-					bfree(filter->audio_source_name);
-					filter->audio_source_name = NULL;
-				}
-			}
+			shader_filter_update_audio_capture(filter, settings, audio_source);
+			obs_source_release(audio_source);
 		}
 	} else {
-		if (filter->volmeter) {
-			obs_volmeter_destroy(filter->volmeter);
-			filter->volmeter = NULL;
-		}
+		shader_filter_update_audio_capture(filter, settings, NULL);
 		if (filter->audio_source_name) {
 			bfree(filter->audio_source_name);
 			filter->audio_source_name = NULL;
@@ -2658,9 +4333,16 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 				}
 				obs_source_release(source);
 				if (param->image) {
-					gs_image_file_free(param->image);
+					image_cache_release(param->image);
 					param->image = NULL;
 				}
+				if (param->sequence) {
+					obs_enter_graphics();
+					struct image_sequence *old_sequence = param->sequence;
+					param->sequence = NULL;
+					obs_leave_graphics();
+					image_sequence_destroy(old_sequence);
+				}
 				dstr_free(&param->path);
 			} else {
 				const char *path = default_value;
@@ -2686,23 +4368,43 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 					}
 				}
 				path = obs_data_get_string(settings, param_name);
-				bool n = false;
-				if (param->image == NULL) {
-					param->image = bzalloc(sizeof(gs_image_file_t));
-					n = true;
-				}
-				if (n || !path || !param->path.array || strcmp(path, param->path.array) != 0) {
-
-					if (!n) {
+				if (param->widget_type.array && strcmp(param->widget_type.array, "sequence") == 0) {
+					struct dstr setting_name = {0};
+					dstr_printf(&setting_name, "%s_fps", param_name);
+					obs_data_set_default_double(settings, setting_name.array, 30.0);
+					const double fps = obs_data_get_double(settings, setting_name.array);
+					dstr_printf(&setting_name, "%s_loop", param_name);
+					obs_data_set_default_bool(settings, setting_name.array, true);
+					const bool loop = obs_data_get_bool(settings, setting_name.array);
+					dstr_free(&setting_name);
+					if (!param->sequence || !param->path.array || strcmp(path, param->path.array) != 0 ||
+					    param->sequence_fps != fps || param->sequence_loop != loop) {
+						struct image_sequence *sequence = image_sequence_create(path, fps, loop);
 						obs_enter_graphics();
-						gs_image_file_free(param->image);
+						struct image_sequence *old_sequence = param->sequence;
+						param->sequence = sequence;
 						obs_leave_graphics();
+						image_sequence_destroy(old_sequence);
+						dstr_copy(&param->path, path);
+						param->sequence_fps = fps;
+						param->sequence_loop = loop;
 					}
-					gs_image_file_init(param->image, path);
-					dstr_copy(&param->path, path);
+				} else if (!param->image || !path || !param->path.array || strcmp(path, param->path.array) != 0 ||
+				    param->image->mtime != image_cache_get_mtime(path) ||
+				    (filter->predecode_images && !param->image->predecode)) {
+					// Decoded in the background, the parameter stays unbound until the image is ready.
+					bool hit = false;
+					struct image_cache_entry *image = image_cache_acquire(path, filter->predecode_images, &hit);
+					if (hit)
+						filter->image_cache_hits++;
+					else if (image)
+						filter->image_cache_misses++;
 					obs_enter_graphics();
-					gs_image_file_init_texture(param->image);
+					struct image_cache_entry *old_image = param->image;
+					param->image = image;
 					obs_leave_graphics();
+					image_cache_release(old_image);
+					dstr_copy(&param->path, path);
 				}
 				obs_source_t *old_source = obs_weak_source_get_source(param->source);
 				if (old_source) {
@@ -2729,18 +4431,255 @@ static void shader_filter_update(void *data, obs_data_t *settings)
 		}
 		bfree(default_value);
 	}
+	filter->update_time_ns += os_gettime_ns() - update_start;
+	filter->update_count++;
+	trace_end(update_name, filter->trace_id, TRACE_THREAD_SETTINGS, trace_start);
+	profile_end(update_name);
 }
 
-static void shader_filter_tick(void *data, float seconds)
+// Video thread, from shader_filter_tick only. Runs the compile that shader_filter_update deferred, with the current
+// settings. Show and activate may run on another thread while the graphics thread renders with the parameters this
+// rebuilds, so they leave it to the next tick, which sees the parent showing or active.
+static void shader_filter_compile_deferred(struct shader_filter_data *filter)
 {
-	struct shader_filter_data *filter = data;
-	obs_source_t *target = filter->transition ? filter->context : obs_filter_get_target(filter->context);
-	if (!target)
+	if (!os_atomic_set_bool(&filter->compile_deferred, false))
 		return;
-	// Determine offsets from expansion values.
-	int base_width = obs_source_get_base_width(target);
-	int base_height = obs_source_get_base_height(target);
+	filter->compile_requested = true;
+	filter->evicted = false;
+	filter->hidden_since = 0;
+	obs_data_t *settings = obs_source_get_settings(filter->context);
+	shader_filter_update(filter, settings);
+	obs_data_release(settings);
+}
+
+static void destroy_texrender(gs_texrender_t **texrender)
+{
+	gs_texrender_destroy(*texrender);
+	*texrender = NULL;
+}
+
+// Video thread. Evicted resources are restored by shader_filter_compile_deferred in the first tick that finds the filter
+// in view again. Restoring them on show or activate would rebuild them on another thread while the filter renders.
+static void shader_filter_mark_evicted(struct shader_filter_data *filter)
+{
+	filter->evicted = true;
+	filter->evictions++;
+	filter->compile_deferred = true;
+}
+
+// Releases the textures of image and sequence parameters on the decode thread. Returns whether there were any.
+static bool shader_filter_evict_images(struct shader_filter_data *filter)
+{
+	bool released = false;
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		obs_enter_graphics();
+		struct image_cache_entry *image = param->image;
+		struct image_sequence *sequence = param->sequence;
+		param->image = NULL;
+		param->sequence = NULL;
+		obs_leave_graphics();
+		image_release_deferred(image, sequence);
+		released |= image || sequence;
+	}
+	return released;
+}
+
+// Releases the input, output and history texrenders, the image statistics targets and the texrenders of source
+// parameters. They are created again on the next render.
+static void shader_filter_evict_textures(struct shader_filter_data *filter)
+{
+	obs_enter_graphics();
+	destroy_texrender(&filter->input_texrender);
+	destroy_texrender(&filter->previous_input_texrender);
+	destroy_texrender(&filter->output_texrender);
+	destroy_texrender(&filter->previous_output_texrender);
+	for (size_t i = 0; i < IMAGE_HISTORY_MAX; i++)
+		destroy_texrender(&filter->history[i]);
+	for (size_t i = 0; i < filter->output_tiles.num; i++)
+		destroy_texrender(&filter->output_tiles.array[i]);
+	for (size_t i = 0; i < IMAGE_STATS_LEVELS; i++)
+		destroy_texrender(&filter->stats_levels[i]);
+	destroy_texrender(&filter->stats_histogram);
+	for (size_t i = 0; i < filter->stored_param_list.num; i++)
+		destroy_texrender(&filter->stored_param_list.array[i].render);
+	obs_leave_graphics();
+}
+
+// Video thread. Frees what a hidden filter rebuilds on its own, with evict_effects also the effect. The settings still
+// hold everything needed to restore it.
+static void shader_filter_evict(struct shader_filter_data *filter)
+{
+	obs_enter_graphics();
+	const uint64_t vram = shader_filter_owned_vram(filter) + shader_filter_unshared_image_vram(filter);
+	obs_leave_graphics();
+	shader_filter_evict_textures(filter);
+	shader_filter_evict_images(filter);
+
+	if (evict_effects && filter->effect) {
+		shader_filter_clear_params(filter);
+		free_image_stats(filter);
+		obs_enter_graphics();
+		gs_effect_destroy(filter->effect);
+		filter->effect = NULL;
+		obs_leave_graphics();
+		filter->reload_effect = true;
+	}
+
+	shader_filter_mark_evicted(filter);
+	blog(LOG_DEBUG, "[obs-shaderfilter] Released %.1f MB of '%s' after %.0f s hidden", (double)vram / (1024.0 * 1024.0),
+	     obs_source_get_name(filter->context), (double)(os_gettime_ns() - filter->hidden_since) / 1000000000.0);
+}
+
+// Video thread, once per tick.
+static void shader_filter_tick_eviction(struct shader_filter_data *filter)
+{
+	if (!evict_after_ns || filter->transition || filter->compile_deferred)
+		return;
+	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	if (!parent || obs_source_showing(parent) || obs_source_active(parent)) {
+		filter->hidden_since = 0;
+		return;
+	}
+	const uint64_t now = os_gettime_ns();
+	if (!filter->hidden_since)
+		filter->hidden_since = now;
+	else if (now - filter->hidden_since >= evict_after_ns)
+		shader_filter_evict(filter);
+}
+
+static int compare_last_render_time(const void *a, const void *b)
+{
+	const struct shader_filter_data *filter_a = *(struct shader_filter_data *const *)a;
+	const struct shader_filter_data *filter_b = *(struct shader_filter_data *const *)b;
+	if (filter_a->last_render_time == filter_b->last_render_time)
+		return 0;
+	return filter_a->last_render_time < filter_b->last_render_time ? -1 : 1;
+}
+
+// Graphics context held. Texture memory of the filter's sequence parameters, released together with its images.
+static uint64_t shader_filter_sequence_vram(struct shader_filter_data *filter)
+{
+	uint64_t vram = 0;
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		if (param->sequence)
+			vram += texture_vram(param->sequence->texture);
+	}
+	return vram;
+}
+
+static bool shader_filter_has_images(struct shader_filter_data *filter)
+{
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		if (filter->stored_param_list.array[i].image || filter->stored_param_list.array[i].sequence)
+			return true;
+	}
+	return false;
+}
+
+// Video thread. When the plugin's textures exceed vram_budget, asks the least recently rendered filters to release
+// their images first and then their texrenders, until the expected usage fits again. Each filter releases its own
+// resources in its next tick (see shader_filter_tick_vram_release), nothing is freed here.
+static void vram_budget_tick(void)
+{
+	const uint64_t now = os_gettime_ns();
+	if (!vram_budget || now - vram_budget_checked < VRAM_BUDGET_INTERVAL_NS)
+		return;
+	vram_budget_checked = now;
+	const uint64_t frame_time = obs_get_video_frame_time();
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&filter_registry_mutex);
+	const uint64_t before = plugin_vram();
+	if (before <= vram_budget) {
+		vram_budget_exceeded = false;
+		pthread_mutex_unlock(&filter_registry_mutex);
+		obs_leave_graphics();
+		return;
+	}
+
+	DARRAY(struct shader_filter_data *) candidates = {0};
+	for (size_t i = 0; i < filter_registry.num; i++) {
+		struct shader_filter_data *filter = filter_registry.array[i];
+		// Offline filters are never ticked, so they would never release anything.
+		if (!filter->transition && !filter->offline && !filter->vram_release &&
+		    frame_time - filter->last_render_time > VRAM_BUDGET_IN_USE_NS)
+			da_push_back(candidates, &filter);
+	}
+	if (candidates.num)
+		qsort(candidates.array, candidates.num, sizeof(struct shader_filter_data *), compare_last_render_time);
+
+	// What a release frees is estimated up front, shared images only count for the last filter holding them.
+	uint64_t used = before;
+	long images = 0;
+	long textures = 0;
+	for (size_t i = 0; used > vram_budget && i < candidates.num; i++) {
+		struct shader_filter_data *filter = candidates.array[i];
+		if (!shader_filter_has_images(filter))
+			continue;
+		const uint64_t freed = shader_filter_unshared_image_vram(filter) + shader_filter_sequence_vram(filter);
+		filter->vram_release |= VRAM_RELEASE_IMAGES;
+		used -= freed < used ? freed : used;
+		images++;
+	}
+	for (size_t i = 0; used > vram_budget && i < candidates.num; i++) {
+		struct shader_filter_data *filter = candidates.array[i];
+		uint64_t freed = shader_filter_owned_vram(filter);
+		if (filter->vram_release & VRAM_RELEASE_IMAGES)
+			freed -= shader_filter_sequence_vram(filter);
+		if (!freed)
+			continue;
+		filter->vram_release |= VRAM_RELEASE_TEXTURES;
+		used -= freed < used ? freed : used;
+		textures++;
+	}
+	da_free(candidates);
+	pthread_mutex_unlock(&filter_registry_mutex);
+	obs_leave_graphics();
+
+	if (images || textures)
+		blog(LOG_INFO,
+		     "[obs-shaderfilter] VRAM use %.1f MB over the %.1f MB budget, releasing images of %ld and textures of %ld "
+		     "filters, about %.1f MB after",
+		     (double)before / (1024.0 * 1024.0), (double)vram_budget / (1024.0 * 1024.0), images, textures,
+		     (double)used / (1024.0 * 1024.0));
+	if (used > vram_budget && !vram_budget_exceeded)
+		blog(LOG_WARNING, "[obs-shaderfilter] Filters on screen need %.1f MB, more than the %.1f MB budget",
+		     (double)used / (1024.0 * 1024.0), (double)vram_budget / (1024.0 * 1024.0));
+	vram_budget_exceeded = used > vram_budget;
+}
+
+// Video thread, once per tick. Releases what vram_budget_tick asked for, unless the filter got rendered since.
+static void shader_filter_tick_vram_release(struct shader_filter_data *filter)
+{
+	const int release = filter->vram_release;
+	if (!release)
+		return;
+	filter->vram_release = 0;
+	if (obs_get_video_frame_time() - filter->last_render_time <= VRAM_BUDGET_IN_USE_NS)
+		return;
+	bool released = false;
+	if ((release & VRAM_RELEASE_IMAGES) && shader_filter_evict_images(filter)) {
+		os_atomic_inc_long(&vram_image_evictions);
+		released = true;
+	}
+	if (release & VRAM_RELEASE_TEXTURES) {
+		shader_filter_evict_textures(filter);
+		os_atomic_inc_long(&vram_texture_evictions);
+		released = true;
+	}
+	if (released)
+		shader_filter_mark_evicted(filter);
+}
 
+// libobs has no query for the largest texture the device supports. 8192 works on every backend OBS runs on, a larger
+// "Tile size" raises the limit for devices known to support it.
+#define MAX_TEXTURE_SIZE 8192
+#define MIN_TILE_SIZE 256
+
+static void shader_filter_set_size(struct shader_filter_data *filter, int base_width, int base_height)
+{
 	filter->total_width = filter->expand_left + base_width + filter->expand_right;
 	filter->total_height = filter->expand_top + base_height + filter->expand_bottom;
 
@@ -2756,6 +4695,116 @@ static void shader_filter_tick(void *data, float seconds)
 	filter->uv_pixel_interval.x = 1.0f / base_width;
 	filter->uv_pixel_interval.y = 1.0f / base_height;
 
+	// Outputs larger than the tile size, MAX_TEXTURE_SIZE by default, are tiled. The input only holds the stretched
+	// source, so it loses nothing at the source size.
+	filter->tile_extent = filter->tile_size ? (filter->tile_size < MIN_TILE_SIZE ? MIN_TILE_SIZE : filter->tile_size)
+						: MAX_TEXTURE_SIZE;
+	filter->tiled = filter->total_width > filter->tile_extent || filter->total_height > filter->tile_extent;
+	filter->tile_columns = filter->tiled ? (filter->total_width + filter->tile_extent - 1) / filter->tile_extent : 1;
+	filter->tile_rows = filter->tiled ? (filter->total_height + filter->tile_extent - 1) / filter->tile_extent : 1;
+	filter->input_width = filter->tiled ? base_width : filter->total_width;
+	filter->input_height = filter->tiled ? base_height : filter->total_height;
+}
+
+// Video thread, where updates run as well. The stats of every filter are snapshotted here every STATS_SNAPSHOT_INTERVAL_NS
+// for shader_filter_get_stats, which can be called from any thread and so never reads the parameters itself.
+static void shader_filter_snapshot_stats(struct shader_filter_data *filter)
+{
+	const uint64_t now = os_gettime_ns();
+	if (filter->stats_snapshot && now - filter->stats_snapshot_time < STATS_SNAPSHOT_INTERVAL_NS)
+		return;
+	filter->stats_snapshot_time = now;
+
+	obs_enter_graphics();
+	const uint64_t vram = shader_filter_owned_vram(filter);
+	obs_leave_graphics();
+
+	obs_data_t *stats = obs_data_create();
+	obs_data_set_string(stats, "name", obs_source_get_name(filter->context));
+	obs_data_set_string(stats, "type", filter->transition ? "transition" : "filter");
+	if (!filter->transition) {
+		obs_source_t *parent = obs_filter_get_parent(filter->context);
+		obs_data_set_string(stats, "parent", parent ? obs_source_get_name(parent) : "");
+	}
+	obs_data_set_string(stats, "shader", filter->shader_id.array ? filter->shader_id.array : "");
+	obs_data_set_bool(stats, "compiled", filter->effect != NULL);
+	obs_data_set_bool(stats, "compile_deferred", filter->compile_deferred && !filter->evicted);
+	obs_data_set_bool(stats, "evicted", filter->evicted);
+	obs_data_set_int(stats, "evictions", filter->evictions);
+	obs_data_set_double(stats, "last_render_age_s",
+			    filter->last_render_time
+				    ? (double)(obs_get_video_frame_time() - filter->last_render_time) / 1000000000.0
+				    : -1.0);
+	obs_data_set_double(stats, "compile_time_ms", (double)filter->compile_time_ns / 1000000.0);
+	obs_data_set_int(stats, "image_cache_hits", filter->image_cache_hits);
+	obs_data_set_int(stats, "image_cache_misses", filter->image_cache_misses);
+	obs_data_set_int(stats, "vram_bytes", (long long)vram);
+	obs_data_set_int(stats, "tiles", filter->tiled ? (long long)filter->tile_columns * filter->tile_rows : 0);
+	obs_data_set_int(stats, "frames_rendered", (long long)filter->frames_rendered);
+	obs_data_set_int(stats, "frames_skipped", (long long)filter->frames_skipped);
+	obs_data_set_double(stats, "cpu_us_per_frame", filter->cpu_us_per_frame);
+	obs_data_set_double(stats, "cpu_ms_total", (double)filter->cpu_time_ns / 1000000.0);
+	if (alloc_counter) {
+		obs_data_set_double(stats, "allocs_per_frame", filter->allocs_per_frame);
+		obs_data_set_int(stats, "allocs_total", filter->cpu_allocs);
+	}
+	obs_data_set_int(stats, "updates", (long long)filter->update_count);
+	obs_data_set_double(stats, "update_ms_total", (double)filter->update_time_ns / 1000000.0);
+
+	obs_data_array_t *sources = obs_data_array_create();
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = filter->stored_param_list.array + i;
+		obs_source_t *source = param->source ? obs_weak_source_get_source(param->source) : NULL;
+		if (!source)
+			continue;
+		obs_data_t *item = obs_data_create();
+		obs_data_set_string(item, "param", param->name.array);
+		obs_data_set_string(item, "source", obs_source_get_name(source));
+		obs_data_array_push_back(sources, item);
+		obs_data_release(item);
+		obs_source_release(source);
+	}
+	obs_data_set_array(stats, "texture_sources", sources);
+	obs_data_array_release(sources);
+
+	pthread_mutex_lock(&filter_stats_mutex);
+	obs_data_t *old_stats = filter->stats_snapshot;
+	filter->stats_snapshot = stats;
+	filter->stats_snapshot_vram = vram;
+	pthread_mutex_unlock(&filter_stats_mutex);
+	obs_data_release(old_stats);
+}
+
+// Video thread. Also true when the filter was rendered in the last frame without its parent showing, e.g. in a projector.
+static bool shader_filter_in_view(struct shader_filter_data *filter)
+{
+	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	if (parent && (obs_source_showing(parent) || obs_source_active(parent)))
+		return true;
+	return filter->last_render_time &&
+	       obs_get_video_frame_time() - filter->last_render_time <= 2 * obs_get_frame_interval_ns();
+}
+
+static void shader_filter_tick(void *data, float seconds)
+{
+	struct shader_filter_data *filter = data;
+	trace_frame();
+	obs_source_t *target = filter->transition ? filter->context : obs_filter_get_target(filter->context);
+	if (!target || filter->offline)
+		return;
+	if (filter->compile_deferred &&
+	    (shader_filter_in_view(filter) || (!filter->evicted && lazy_compile_claim_idle_frame())))
+		shader_filter_compile_deferred(filter);
+	shader_filter_tick_eviction(filter);
+	shader_filter_tick_vram_release(filter);
+	vram_budget_tick();
+	profile_start(tick_name);
+	const uint64_t trace_start = trace_begin();
+	const struct cpu_sample cpu = cpu_sample_begin();
+	seconds = input_stream_begin_tick(filter, seconds);
+	// Determine offsets from expansion values.
+	shader_filter_set_size(filter, obs_source_get_base_width(target), obs_source_get_base_height(target));
+
 	if (filter->shader_start_time == 0.0f) {
 		filter->shader_start_time = filter->elapsed_time + seconds;
 	}
@@ -2790,16 +4839,31 @@ static void shader_filter_tick(void *data, float seconds)
 	// undecided between this and "rand_float(1);"
 	filter->rand_f = (float)((double)rand_interval(0, 10000) / (double)10000);
 
-	if (filter->volmeter) {
-		filter->audio_peak = filter->current_audio_peak;
-		filter->audio_magnitude = filter->current_audio_magnitude;
-	} else {
-		filter->audio_peak = 0.0f;
-		filter->audio_magnitude = 0.0f;
+	shader_filter_tick_audio_levels(filter, seconds);
+	input_stream_end_tick(filter, seconds);
+
+	bool has_images = false;
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		image_sequence_tick(filter->stored_param_list.array[i].sequence, seconds);
+		has_images |= filter->stored_param_list.array[i].image != NULL;
+	}
+	if (has_images) {
+		const uint64_t frame_time = obs_get_video_frame_time();
+		obs_enter_graphics();
+		for (size_t i = 0; i < filter->stored_param_list.num; i++)
+			image_cache_tick(filter->stored_param_list.array[i].image, frame_time);
+		obs_leave_graphics();
 	}
 
+	gpu_timer_tick(filter);
+
 	filter->output_rendered = false;
 	filter->input_rendered = false;
+	cpu_sample_end(filter, cpu);
+	cpu_stats_frame(filter);
+	shader_filter_snapshot_stats(filter);
+	trace_end(tick_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+	profile_end(tick_name);
 }
 
 gs_texrender_t *create_or_reset_texrender(gs_texrender_t *render)
@@ -2816,6 +4880,8 @@ static void get_input_source(struct shader_filter_data *filter)
 {
 	if (filter->input_rendered)
 		return;
+	profile_start(get_input_source_name);
+	const uint64_t trace_start = trace_begin();
 
 	// Use the OBS default effect file as our effect.
 	gs_effect_t *pass_through = obs_get_base_effect(OBS_EFFECT_DEFAULT);
@@ -2832,7 +4898,13 @@ static void get_input_source(struct shader_filter_data *filter)
 
 	const enum gs_color_format format = gs_get_format_from_space(source_space);
 
-	if (filter->param_previous_image) {
+	if (filter->history_depth && filter->history_downscale <= 1) {
+		// Last frame's capture becomes the newest history frame, the oldest one is reused for this capture.
+		filter->history_head = (filter->history_head + 1) % filter->history_depth;
+		gs_texrender_t *temp = filter->history[filter->history_head];
+		filter->history[filter->history_head] = filter->input_texrender;
+		filter->input_texrender = temp;
+	} else if (filter->param_previous_image) {
 		gs_texrender_t *temp = filter->input_texrender;
 		filter->input_texrender = filter->previous_input_texrender;
 		filter->previous_input_texrender = temp;
@@ -2844,10 +4916,13 @@ static void get_input_source(struct shader_filter_data *filter)
 	// Start the rendering process with our correct color space params,
 	// And set up your texrender to recieve the created texture.
 	if (!filter->transition &&
-	    !obs_source_process_filter_begin_with_color_space(filter->context, format, source_space, OBS_NO_DIRECT_RENDERING))
+	    !obs_source_process_filter_begin_with_color_space(filter->context, format, source_space, OBS_NO_DIRECT_RENDERING)) {
+		trace_end(get_input_source_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+		profile_end(get_input_source_name);
 		return;
+	}
 
-	if (gs_texrender_begin(filter->input_texrender, filter->total_width, filter->total_height)) {
+	if (gs_texrender_begin(filter->input_texrender, filter->input_width, filter->input_height)) {
 
 		gs_blend_state_push();
 		gs_reset_blend_state();
@@ -2868,10 +4943,33 @@ static void get_input_source(struct shader_filter_data *filter)
 		gs_blend_state_pop();
 		filter->input_rendered = true;
 	}
+	trace_end(get_input_source_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+	profile_end(get_input_source_name);
+}
+
+// Draws the tiles from render_shader_tiles next to each other straight into the current target, which can be larger
+// than any single texture. Called between obs_source_process_filter_begin_with_color_space and the end of the filter,
+// every tile is drawn by obs_source_process_filter_tech_end so it gets the same sRGB handling as a single output.
+static void draw_output_tiles(struct shader_filter_data *filter)
+{
+	for (size_t i = 0; i < filter->output_tiles.num; i++) {
+		gs_texture_t *tile = gs_texrender_get_texture(filter->output_tiles.array[i]);
+		if (!tile)
+			continue;
+		gs_effect_set_texture(filter->param_output_image, tile);
+		gs_matrix_push();
+		gs_matrix_translate3f((float)((int)i % filter->tile_columns * filter->tile_extent),
+				      (float)((int)i / filter->tile_columns * filter->tile_extent), 0.0f);
+		obs_source_process_filter_tech_end(filter->context, filter->output_effect, gs_texture_get_width(tile),
+						   gs_texture_get_height(tile), "Draw");
+		gs_matrix_pop();
+	}
 }
 
 static void draw_output(struct shader_filter_data *filter)
 {
+	profile_start(draw_output_name);
+	const uint64_t trace_start = trace_begin();
 	const enum gs_color_space preferred_spaces[] = {
 		GS_CS_SRGB,
 		GS_CS_SRGB_16F,
@@ -2883,7 +4981,18 @@ static void draw_output(struct shader_filter_data *filter)
 
 	const enum gs_color_format format = gs_get_format_from_space(source_space);
 
-	if (!obs_source_process_filter_begin_with_color_space(filter->context, format, source_space, OBS_NO_DIRECT_RENDERING)) {
+	// Tiles can only be drawn through the output effect, the default effect would draw the input instead.
+	if ((filter->tiled && (!filter->output_effect || !filter->param_output_image)) ||
+	    !obs_source_process_filter_begin_with_color_space(filter->context, format, source_space, OBS_NO_DIRECT_RENDERING)) {
+		trace_end(draw_output_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+		profile_end(draw_output_name);
+		return;
+	}
+
+	if (filter->tiled) {
+		draw_output_tiles(filter);
+		trace_end(draw_output_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+		profile_end(draw_output_name);
 		return;
 	}
 
@@ -2897,10 +5006,13 @@ static void draw_output(struct shader_filter_data *filter)
 	}
 
 	obs_source_process_filter_end(filter->context, pass_through, filter->total_width, filter->total_height);
+	trace_end(draw_output_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+	profile_end(draw_output_name);
 }
 
 void shader_filter_set_effect_params(struct shader_filter_data *filter)
 {
+	profile_start(set_effect_params_name);
 
 	if (filter->param_uv_scale != NULL) {
 		gs_effect_set_vec2(filter->param_uv_scale, &filter->uv_scale);
@@ -2911,7 +5023,9 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 	if (filter->param_uv_pixel_interval != NULL) {
 		gs_effect_set_vec2(filter->param_uv_pixel_interval, &filter->uv_pixel_interval);
 	}
-	if (filter->param_current_time_ms != NULL) {
+	if (filter->param_current_time_ms != NULL && filter->clock_override) {
+		gs_effect_set_int(filter->param_current_time_ms, (int)(filter->clock_ms % 1000));
+	} else if (filter->param_current_time_ms != NULL) {
 #ifdef _WIN32
 		SYSTEMTIME system_time;
 		GetSystemTime(&system_time);
@@ -2926,7 +5040,7 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 	    filter->param_current_time_hour != NULL || filter->param_current_time_day_of_week != NULL ||
 	    filter->param_current_time_day_of_month != NULL || filter->param_current_time_month != NULL ||
 	    filter->param_current_time_day_of_year != NULL || filter->param_current_time_year != NULL) {
-		time_t t = time(NULL);
+		time_t t = filter->clock_override ? (time_t)(filter->clock_ms / 1000) : time(NULL);
 		struct tm *lt = localtime(&t);
 		if (filter->param_current_time_sec != NULL)
 			gs_effect_set_int(filter->param_current_time_sec, lt->tm_sec);
@@ -2969,9 +5083,31 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 	if (filter->param_audio_peak != NULL) {
 		gs_effect_set_float(filter->param_audio_peak, filter->audio_peak);
 	}
+	if (filter->param_audio_beat != NULL) {
+		gs_effect_set_float(filter->param_audio_beat, filter->audio_beat_value);
+	}
+	if (filter->param_audio_beat_phase != NULL) {
+		gs_effect_set_float(filter->param_audio_beat_phase, filter->audio_beat_phase);
+	}
+	if (filter->param_audio_bpm != NULL) {
+		gs_effect_set_float(filter->param_audio_bpm, filter->audio_bpm);
+	}
+	if (filter->param_audio_bass != NULL) {
+		gs_effect_set_float(filter->param_audio_bass, filter->audio_bass);
+	}
+	if (filter->param_audio_mid != NULL) {
+		gs_effect_set_float(filter->param_audio_mid, filter->audio_mid);
+	}
+	if (filter->param_audio_treble != NULL) {
+		gs_effect_set_float(filter->param_audio_treble, filter->audio_treble);
+	}
 	if (filter->param_audio_magnitude != NULL) {
 		gs_effect_set_float(filter->param_audio_magnitude, filter->audio_magnitude);
 	}
+	if (filter->param_audio_spectrum != NULL) {
+		gs_effect_set_texture(filter->param_audio_spectrum,
+				      deterministic ? NULL : audio_spectrum_get_texture(filter->audio_spectrum));
+	}
 	if (filter->param_loops != NULL) {
 		gs_effect_set_int(filter->param_loops, filter->loops);
 	}
@@ -2987,6 +5123,16 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 	if (filter->param_rand_instance_f != NULL) {
 		gs_effect_set_float(filter->param_rand_instance_f, filter->rand_instance_f);
 	}
+	if (filter->param_image_avg_luma != NULL) {
+		gs_effect_set_float(filter->param_image_avg_luma, filter->image_avg_luma);
+	}
+	if (filter->param_image_min_max != NULL) {
+		gs_effect_set_vec2(filter->param_image_min_max, &filter->image_min_max);
+	}
+	if (filter->param_image_histogram != NULL) {
+		gs_effect_set_texture(filter->param_image_histogram,
+				      filter->stats_histogram ? gs_texrender_get_texture(filter->stats_histogram) : NULL);
+	}
 
 	size_t param_count = filter->stored_param_list.num;
 	for (size_t param_index = 0; param_index < param_count; param_index++) {
@@ -3031,6 +5177,7 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 				} else {
 					gs_texrender_reset(param->render);
 				}
+				const uint64_t trace_start = trace_begin();
 				uint32_t base_width = obs_source_get_base_width(source);
 				uint32_t base_height = obs_source_get_base_height(source);
 				gs_blend_state_push();
@@ -3054,11 +5201,14 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 					gs_texrender_end(param->render);
 				}
 				gs_blend_state_pop();
+				trace_end(texture_source_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
 				obs_source_release(source);
 				gs_texture_t *tex = gs_texrender_get_texture(param->render);
 				gs_effect_set_texture(param->param, tex);
+			} else if (param->sequence) {
+				gs_effect_set_texture(param->param, image_sequence_get_texture(param->sequence));
 			} else if (param->image) {
-				gs_effect_set_texture(param->param, param->image->texture);
+				gs_effect_set_texture(param->param, image_cache_get_texture(param->image));
 			} else {
 				gs_effect_set_texture(param->param, NULL);
 			}
@@ -3071,147 +5221,708 @@ void shader_filter_set_effect_params(struct shader_filter_data *filter)
 		default:;
 		}
 	}
+	profile_end(set_effect_params_name);
 }
 
-static void build_sprite(struct gs_vb_data *data, float fcx, float fcy, float start_u, float end_u, float start_v, float end_v)
+static bool shader_samples_image_at_uv_only(const char *shader_text)
 {
-	struct vec2 *tvarray = data->tvarray[0].array;
-
-	vec3_zero(data->points);
-	vec3_set(data->points + 1, fcx, 0.0f, 0.0f);
-	vec3_set(data->points + 2, 0.0f, fcy, 0.0f);
-	vec3_set(data->points + 3, fcx, fcy, 0.0f);
-	vec2_set(tvarray, start_u, start_v);
-	vec2_set(tvarray + 1, end_u, start_v);
-	vec2_set(tvarray + 2, start_u, end_v);
-	vec2_set(tvarray + 3, end_u, end_v);
+	struct dstr check = {0};
+	dstr_copy(&check, shader_text);
+	dstr_replace(&check, "image.Sample(textureSampler, v_in.uv)", "");
+	dstr_replace(&check, "image.Sample(textureSampler,v_in.uv)", "");
+
+	// Any other reference to image is neighbourhood sampling or something we can not inline.
+	bool at_uv_only = true;
+	const char *pos = strstr(check.array, "image");
+	while (pos) {
+		if ((pos == check.array || !is_var_char(*(pos - 1))) && !is_var_char(*(pos + 5))) {
+			at_uv_only = false;
+			break;
+		}
+		pos = strstr(pos + 5, "image");
+	}
+	dstr_free(&check);
+	return at_uv_only && strstr(shader_text, "mainImage(VertData v_in)") != NULL;
 }
 
-static inline void build_sprite_norm(struct gs_vb_data *data, float fcx, float fcy)
+static bool shader_filter_can_fuse(struct shader_filter_data *filter)
 {
-	build_sprite(data, fcx, fcy, 0.0f, 1.0f, 0.0f, 1.0f);
+	if (filter->transition || !filter->effect || !filter->use_template || dstr_is_empty(&filter->shader_body))
+		return false;
+	if (filter->expand_left || filter->expand_right || filter->expand_top || filter->expand_bottom)
+		return false;
+	if (filter->param_previous_image || filter->param_previous_output || filter->stats_effect || filter->history_depth ||
+	    filter->param_audio_spectrum)
+		return false;
+	if (filter->fuse_checked_generation != filter->effect_generation) {
+		filter->fuse_compatible = shader_samples_image_at_uv_only(filter->shader_body.array);
+		filter->fuse_checked_generation = filter->effect_generation;
+	}
+	return filter->fuse_compatible;
 }
 
-static void render_shader(struct shader_filter_data *filter, float f, obs_source_t *filter_to)
+static void fuse_add_name(struct darray *names_da, const char *start, size_t len)
 {
-	gs_texture_t *texture = gs_texrender_get_texture(filter->input_texrender);
-	if (!texture) {
+	DARRAY(struct dstr) names;
+	names.da = *names_da;
+	if (len == 9 && strncmp(start, "mainImage", 9) == 0)
 		return;
+	for (size_t i = 0; i < names.num; i++) {
+		if (names.array[i].len == len && strncmp(names.array[i].array, start, len) == 0)
+			return;
 	}
+	struct dstr *name = da_push_back_new(names);
+	dstr_ncopy(name, start, len);
+	*names_da = names.da;
+}
 
-	if (filter->param_previous_output) {
-		gs_texrender_t *temp = filter->output_texrender;
-		filter->output_texrender = filter->previous_output_texrender;
-		filter->previous_output_texrender = temp;
+// Collect every name a shader declares at global scope (uniforms, functions, structs, samplers and
+// globals) so each fused stage can be renamed into its own namespace.
+static void fuse_collect_names(const char *text, struct darray *names)
+{
+	int depth = 0;
+	bool annotation = false;
+	const char *prev = NULL;
+	const char *ch = text;
+	while (*ch) {
+		if (*ch == '/' && *(ch + 1) == '/') {
+			while (*ch && *ch != '\n')
+				ch++;
+			continue;
+		}
+		if (*ch == '/' && *(ch + 1) == '*') {
+			const char *end = strstr(ch + 2, "*/");
+			ch = end ? end + 2 : ch + strlen(ch);
+			continue;
+		}
+		if (*ch == '#') {
+			if (strncmp(ch, "#define ", 8) == 0) {
+				const char *start = ch + 8;
+				while (*start == ' ' || *start == '\t')
+					start++;
+				const char *end = start;
+				while (is_var_char(*end))
+					end++;
+				if (end > start)
+					fuse_add_name(names, start, end - start);
+			}
+			while (*ch && *ch != '\n')
+				ch++;
+			prev = NULL;
+			continue;
+		}
+		if (*ch == '"') {
+			ch++;
+			while (*ch && *ch != '"')
+				ch++;
+			if (*ch)
+				ch++;
+			continue;
+		}
+		if (depth == 0 && !annotation && is_var_char(*ch) && (*ch < '0' || *ch > '9')) {
+			const char *start = ch;
+			while (is_var_char(*ch))
+				ch++;
+			const char *next = ch;
+			while (*next == ' ' || *next == '\t' || *next == '\r' || *next == '\n')
+				next++;
+			if (prev && (*next == '(' || *next == '=' || *next == ';' || *next == '<' || *next == '[' ||
+				     *next == '{' || *next == ':'))
+				fuse_add_name(names, start, ch - start);
+			prev = start;
+			continue;
+		}
+		if (*ch == '{') {
+			depth++;
+		} else if (*ch == '}') {
+			depth--;
+		} else if (depth == 0 && *ch == '<' && prev) {
+			annotation = true;
+		} else if (annotation && *ch == '>') {
+			annotation = false;
+		}
+		if (*ch != ' ' && *ch != '\t' && *ch != '\r' && *ch != '\n')
+			prev = NULL;
+		ch++;
 	}
-	filter->output_texrender = create_or_reset_texrender(filter->output_texrender);
+}
 
-	if (filter->param_image)
-		gs_effect_set_texture(filter->param_image, texture);
-	if (filter->param_previous_image)
-		gs_effect_set_texture(filter->param_previous_image, gs_texrender_get_texture(filter->previous_input_texrender));
-	if (filter->param_previous_output)
-		gs_effect_set_texture(filter->param_previous_output, gs_texrender_get_texture(filter->previous_output_texrender));
+// Template uniforms that differ per filter instance, every fused stage gets its own copy.
+static const char *fuse_stage_uniforms[][2] = {
+	{"float", "rand_f"},
+	{"float", "rand_instance_f"},
+	{"float", "rand_activation_f"},
+	{"float", "elapsed_time"},
+	{"float", "elapsed_time_start"},
+	{"float", "elapsed_time_show"},
+	{"float", "elapsed_time_active"},
+	{"float", "elapsed_time_enable"},
+	{"int", "loops"},
+	{"float", "loop_second"},
+	{"float", "local_time"},
+};
 
-	shader_filter_set_effect_params(filter);
+static bool fuse_append_stage(struct dstr *effect_text, struct shader_filter_data *stage, size_t index)
+{
+	struct dstr body = {0};
+	dstr_copy_dstr(&body, &stage->shader_body);
+	dstr_replace(&body, "image.Sample(textureSampler, v_in.uv)", "fuse_input");
+	dstr_replace(&body, "image.Sample(textureSampler,v_in.uv)", "fuse_input");
+
+	// float4 mainImage(VertData v_in) : TARGET becomes float4 fuse<index>_mainImage(VertData v_in, float4 fuse_input)
+	char *main_pos = strstr(body.array, "mainImage(VertData v_in)");
+	char *target = main_pos ? strstr(main_pos, "TARGET") : NULL;
+	if (!target) {
+		dstr_free(&body);
+		return false;
+	}
+	struct dstr main_signature = {0};
+	dstr_printf(&main_signature, "fuse%zu_mainImage(VertData v_in, float4 fuse_input)", index);
+	const size_t main_diff = main_pos - body.array;
+	dstr_remove(&body, main_diff, target + 6 - main_pos);
+	dstr_insert_dstr(&body, main_diff, &main_signature);
+	dstr_free(&main_signature);
+
+	DARRAY(struct dstr) names;
+	da_init(names);
+	fuse_collect_names(stage->shader_body.array, &names.da);
+	for (size_t i = 0; i < OBS_COUNTOF(fuse_stage_uniforms); i++) {
+		struct dstr *name = da_push_back_new(names);
+		dstr_copy(name, fuse_stage_uniforms[i][1]);
+		dstr_catf(effect_text, "uniform %s fuse%zu_%s;\n", fuse_stage_uniforms[i][0], index, fuse_stage_uniforms[i][1]);
+	}
+	for (size_t i = 0; i < names.num; i++)
+		dstr_catf(effect_text, "#define %s fuse%zu_%s\n", names.array[i].array, index, names.array[i].array);
+	dstr_cat_dstr(effect_text, &body);
+	dstr_cat(effect_text, "\n");
+	for (size_t i = 0; i < names.num; i++) {
+		dstr_catf(effect_text, "#undef %s\n", names.array[i].array);
+		dstr_free(&names.array[i]);
+	}
+	da_free(names);
+	dstr_free(&body);
+	return true;
+}
 
-	if (f > 0.0f) {
-		if (filter_to) {
+static void shader_filter_build_fuse(struct shader_filter_data *filter, struct shader_filter_data **stages, size_t count)
+{
+	struct dstr effect_text = {0};
+	dstr_cat(&effect_text, effect_template_begin);
+	for (size_t i = 0; i < count; i++) {
+		if (!fuse_append_stage(&effect_text, stages[i], i)) {
+			dstr_free(&effect_text);
+			return;
+		}
+	}
+	dstr_cat(&effect_text, "\nfloat4 mainImage(VertData v_in) : TARGET\n{\n\tfloat4 fuse_input = image.Sample(textureSampler, v_in.uv);\n");
+	for (size_t i = 0; i < count; i++)
+		dstr_catf(&effect_text, "\tfuse_input = fuse%zu_mainImage(v_in, fuse_input);\n", i);
+	dstr_cat(&effect_text, "\treturn fuse_input;\n}\n");
+	dstr_cat(&effect_text, effect_template_end);
 
-			struct shader_filter_data *filter2 = obs_obj_get_data(filter_to);
-			for (size_t i = 0; i < filter->stored_param_list.num; i++) {
-				struct effect_param_data *param = (filter->stored_param_list.array + i);
-				if (!param->param)
-					continue;
+	char *errors = NULL;
+	prepare_effect_text(&effect_text);
+	gs_effect_t *effect = gs_effect_create(effect_text.array, NULL, &errors);
+	dstr_free(&effect_text);
+	if (!effect) {
+		blog(LOG_INFO, "[obs-shaderfilter] Unable to fuse %zu filters on '%s', rendering them separately:\n%s", count,
+		     obs_source_get_name(filter->context), (errors == NULL || strlen(errors) == 0 ? "(None)" : errors));
+		bfree(errors);
+		return;
+	}
 
-				for (size_t j = 0; j < filter->stored_param_list.num; j++) {
-					struct effect_param_data *param2 = (filter2->stored_param_list.array + i);
-					if (!param2->param)
-						continue;
-					if (param->type != param2->type)
-						continue;
-					if (strcmp(param->name.array, param2->name.array) != 0)
-						continue;
-
-					switch (param->type) {
-					case GS_SHADER_PARAM_FLOAT:
-						gs_effect_set_float(param->param, (float)param2->value.f * f +
-											  (float)param->value.f * (1.0f - f));
-						break;
-					case GS_SHADER_PARAM_INT:
-						gs_effect_set_int(param->param, (int)((double)param2->value.i * f +
-										      (double)param->value.i * (1.0f - f)));
-						break;
-					case GS_SHADER_PARAM_VEC2: {
-						struct vec2 v2;
-						v2.x = (float)param2->value.vec2.x * f + (float)param->value.vec2.x * (1.0f - f);
-						v2.y = (float)param2->value.vec2.y * f + (float)param->value.vec2.y * (1.0f - f);
-						gs_effect_set_vec2(param->param, &v2);
-						break;
-					}
-					case GS_SHADER_PARAM_VEC3: {
-						struct vec3 v3;
-						v3.x = (float)param2->value.vec3.x * f + (float)param->value.vec3.x * (1.0f - f);
-						v3.y = (float)param2->value.vec3.y * f + (float)param->value.vec3.y * (1.0f - f);
-						v3.z = (float)param2->value.vec3.z * f + (float)param->value.vec3.z * (1.0f - f);
-						gs_effect_set_vec3(param->param, &v3);
-						break;
-					}
-					case GS_SHADER_PARAM_VEC4: {
-						struct vec4 v4;
-						v4.x = (float)param2->value.vec4.x * f + (float)param->value.vec4.x * (1.0f - f);
-						v4.y = (float)param2->value.vec4.y * f + (float)param->value.vec4.y * (1.0f - f);
-						v4.z = (float)param2->value.vec4.z * f + (float)param->value.vec4.z * (1.0f - f);
-						v4.w = (float)param2->value.vec4.w * f + (float)param->value.vec4.w * (1.0f - f);
-						gs_effect_set_vec4(param->param, &v4);
-						break;
-					}
-					default:;
-					}
+	struct shader_filter_data *fuse = bzalloc(sizeof(struct shader_filter_data));
+	fuse->context = filter->context;
+	fuse->effect = effect;
+	da_init(fuse->stored_param_list);
+	shader_filter_load_effect_params(fuse);
+	filter->fuse = fuse;
+	for (size_t i = 0; i < count; i++) {
+		struct shader_filter_data *builtins = bzalloc(sizeof(struct shader_filter_data));
+		da_push_back(filter->fuse_stage_builtins, &builtins);
+	}
+
+	// Map every fuse<index>_<name> parameter back to the parameter of the stage it came from, built-in uniforms are
+	// bound to that stage's copy so they get its time, random and audio values.
+	for (size_t i = 0; i < fuse->stored_param_list.num; i++) {
+		struct effect_param_data *param = fuse->stored_param_list.array + i;
+		struct effect_param_data *binding = NULL;
+		size_t index = 0;
+		int name_offset = 0;
+		if (sscanf(param->name.array, "fuse%zu_%n", &index, &name_offset) == 1 && name_offset > 0 && index < count) {
+			struct shader_filter_data *stage = stages[index];
+			for (size_t j = 0; j < stage->stored_param_list.num; j++) {
+				struct effect_param_data *stage_param = stage->stored_param_list.array + j;
+				if (stage_param->type == param->type &&
+				    strcmp(stage_param->name.array, param->name.array + name_offset) == 0) {
+					binding = stage_param;
 					break;
 				}
 			}
+			if (!binding && shader_filter_bind_builtin_param(filter->fuse_stage_builtins.array[index],
+									  param->name.array + name_offset, param->param))
+				param->param = NULL;
+		}
+		da_push_back(filter->fuse_bindings, &binding);
+	}
+}
+
+static void shader_filter_update_fuse(struct shader_filter_data *filter, float f)
+{
+	filter->fuse_active = false;
+	if (!filter->fuse_filters || f > 0.0f || !shader_filter_can_fuse(filter)) {
+		if (filter->fuse_signature)
+			shader_filter_free_fuse(filter);
+		return;
+	}
+
+	// Walk down the filter chain while the filters below only sample image at the current uv.
+	DARRAY(struct shader_filter_data *) stages;
+	DARRAY(obs_source_t *) sources;
+	da_init(stages);
+	da_init(sources);
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	while (target && strcmp(obs_source_get_id(target), "shader_filter") == 0) {
+		if (obs_source_enabled(target)) {
+			struct shader_filter_data *stage = obs_obj_get_data(target);
+			if (!stage || !shader_filter_can_fuse(stage) || stage->use_pm_alpha != filter->use_pm_alpha)
+				break;
+			da_insert(stages, 0, &stage);
+			da_insert(sources, 0, &target);
+		}
+		target = obs_filter_get_target(target);
+	}
+	da_push_back(stages, &filter);
+
+	uint64_t signature = 14695981039346656037ULL;
+	for (size_t i = 0; i < stages.num; i++) {
+		signature = (signature ^ (uint64_t)(uintptr_t)stages.array[i]) * 1099511628211ULL;
+		signature = (signature ^ (uint64_t)stages.array[i]->effect_generation) * 1099511628211ULL;
+	}
+
+	if (stages.num < 2) {
+		if (filter->fuse_signature)
+			shader_filter_free_fuse(filter);
+	} else if (signature != filter->fuse_signature) {
+		shader_filter_free_fuse(filter);
+		for (size_t i = 0; i < sources.num; i++) {
+			obs_source_t *source = obs_source_get_ref(sources.array[i]);
+			if (source)
+				da_push_back(filter->fuse_sources, &source);
+		}
+		shader_filter_build_fuse(filter, stages.array, stages.num);
+		filter->fuse_signature = signature;
+	}
+
+	if (filter->fuse && stages.num >= 2) {
+		const uint64_t frame_time = obs_get_video_frame_time();
+		for (size_t i = 0; i < stages.num - 1; i++)
+			stages.array[i]->fuse_time = frame_time;
+		filter->fuse_active = true;
+	}
+	da_free(stages);
+	da_free(sources);
+}
+
+static gs_effect_t *shader_filter_set_fuse_params(struct shader_filter_data *filter)
+{
+	struct shader_filter_data *fuse = filter->fuse;
+	fuse->uv_offset = filter->uv_offset;
+	fuse->uv_scale = filter->uv_scale;
+	fuse->uv_pixel_interval = filter->uv_pixel_interval;
+	fuse->uv_size = filter->uv_size;
+
+	for (size_t i = 0; i < filter->fuse_stage_builtins.num; i++) {
+		struct shader_filter_data *builtins = filter->fuse_stage_builtins.array[i];
+		struct shader_filter_data *stage = filter;
+		if (i < filter->fuse_sources.num)
+			stage = obs_obj_get_data(filter->fuse_sources.array[i]);
+		if (!stage)
+			continue;
+		builtins->uv_offset = filter->uv_offset;
+		builtins->uv_scale = filter->uv_scale;
+		builtins->uv_pixel_interval = filter->uv_pixel_interval;
+		builtins->uv_size = filter->uv_size;
+		builtins->clock_override = stage->clock_override;
+		builtins->clock_ms = stage->clock_ms;
+		builtins->elapsed_time = stage->elapsed_time;
+		builtins->elapsed_time_loop = stage->elapsed_time_loop;
+		builtins->loops = stage->loops;
+		builtins->local_time = stage->local_time;
+		builtins->rand_f = stage->rand_f;
+		builtins->rand_instance_f = stage->rand_instance_f;
+		builtins->rand_activation_f = stage->rand_activation_f;
+		builtins->audio_peak = stage->audio_peak;
+		builtins->audio_bass = stage->audio_bass;
+		builtins->audio_mid = stage->audio_mid;
+		builtins->audio_treble = stage->audio_treble;
+		builtins->audio_beat_value = stage->audio_beat_value;
+		builtins->audio_beat_phase = stage->audio_beat_phase;
+		builtins->audio_bpm = stage->audio_bpm;
+		builtins->audio_magnitude = stage->audio_magnitude;
+		builtins->shader_start_time = stage->shader_start_time;
+		builtins->shader_show_time = stage->shader_show_time;
+		builtins->shader_active_time = stage->shader_active_time;
+		builtins->shader_enable_time = stage->shader_enable_time;
+		shader_filter_set_effect_params(builtins);
+	}
+
+	for (size_t i = 0; i < fuse->stored_param_list.num; i++) {
+		struct effect_param_data *param = fuse->stored_param_list.array + i;
+		struct effect_param_data *binding = filter->fuse_bindings.array[i];
+		if (!binding)
+			continue;
+		param->value = binding->value;
+		param->source = binding->source;
+		param->image = binding->image;
+		param->sequence = binding->sequence;
+	}
+	shader_filter_set_effect_params(fuse);
+	return fuse->effect;
+}
+
+static void build_sprite(struct gs_vb_data *data, float fcx, float fcy, float start_u, float end_u, float start_v, float end_v)
+{
+	struct vec2 *tvarray = data->tvarray[0].array;
+
+	vec3_zero(data->points);
+	vec3_set(data->points + 1, fcx, 0.0f, 0.0f);
+	vec3_set(data->points + 2, 0.0f, fcy, 0.0f);
+	vec3_set(data->points + 3, fcx, fcy, 0.0f);
+	vec2_set(tvarray, start_u, start_v);
+	vec2_set(tvarray + 1, end_u, start_v);
+	vec2_set(tvarray + 2, start_u, end_v);
+	vec2_set(tvarray + 3, end_u, end_v);
+}
+
+static inline void build_sprite_norm(struct gs_vb_data *data, float fcx, float fcy)
+{
+	build_sprite(data, fcx, fcy, 0.0f, 1.0f, 0.0f, 1.0f);
+}
+
+static void render_image_stats_pass(gs_texrender_t *render, gs_texture_t *source, const char *technique, uint32_t cx,
+				    uint32_t cy)
+{
+	gs_texrender_reset(render);
+	if (!gs_texrender_begin(render, cx, cy))
+		return;
+	// Point samples per block and axis: every source pixel up to IMAGE_STATS_BLOCK_SAMPLES, evenly spread above.
+	struct vec2 block_size, texel_size, block_texels;
+	vec2_set(&block_size, 1.0f / (float)cx, 1.0f / (float)cy);
+	const uint32_t source_cx = gs_texture_get_width(source);
+	const uint32_t source_cy = gs_texture_get_height(source);
+	const uint32_t samples_x = (source_cx + cx - 1) / cx;
+	const uint32_t samples_y = (source_cy + cy - 1) / cy;
+	vec2_set(&block_texels, (float)(samples_x < IMAGE_STATS_BLOCK_SAMPLES ? samples_x : IMAGE_STATS_BLOCK_SAMPLES),
+		 (float)(samples_y < IMAGE_STATS_BLOCK_SAMPLES ? samples_y : IMAGE_STATS_BLOCK_SAMPLES));
+	vec2_div(&texel_size, &block_size, &block_texels);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	gs_effect_set_texture(image_stats_param_image, source);
+	gs_effect_set_vec2(image_stats_param_block_size, &block_size);
+	gs_effect_set_vec2(image_stats_param_texel_size, &texel_size);
+	gs_effect_set_vec2(image_stats_param_block_texels, &block_texels);
+	while (gs_effect_loop(image_stats_effect, technique))
+		gs_draw_sprite(source, 0, cx, cy);
+	gs_texrender_end(render);
+}
+
+// Bins a IMAGE_STATS_HISTOGRAM_GRID square grid of point samples of the input into 256 bins.
+static void render_image_histogram(gs_texrender_t *render, gs_texture_t *source)
+{
+	gs_texrender_reset(render);
+	if (!gs_texrender_begin(render, 256, 1))
+		return;
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, 256.0f, 0.0f, 1.0f, -100.0f, 100.0f);
+	gs_enable_blending(true);
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ONE);
+	gs_effect_set_texture(image_stats_param_image, source);
+	gs_effect_set_float(image_stats_param_histogram_weight,
+			    1.0f / (float)(IMAGE_STATS_HISTOGRAM_GRID * IMAGE_STATS_HISTOGRAM_GRID));
+	gs_load_vertexbuffer(image_stats_points);
+	gs_load_indexbuffer(NULL);
+	while (gs_effect_loop(image_stats_effect, "Histogram"))
+		gs_draw(GS_POINTS, 0, 0);
+	gs_enable_blending(false);
+	gs_texrender_end(render);
+}
+
+static void render_image_stats(struct shader_filter_data *filter, gs_texture_t *texture)
+{
+	if (!filter->stats_effect)
+		return;
+
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_enable_blending(false);
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	// Reduce the input to 64x64, 16x16, 4x4 and 1x1 levels holding average, minimum and maximum luma.
+	gs_texture_t *source = texture;
+	uint32_t size = IMAGE_STATS_SIZE;
+	for (size_t i = 0; i < IMAGE_STATS_LEVELS; i++) {
+		if (!filter->stats_levels[i])
+			filter->stats_levels[i] = gs_texrender_create(GS_RGBA32F, GS_ZS_NONE);
+		render_image_stats_pass(filter->stats_levels[i], source, i == 0 ? "Luma" : "Reduce", size, size);
+		source = gs_texrender_get_texture(filter->stats_levels[i]);
+		if (!source) {
+			gs_blend_state_pop();
+			return;
+		}
+		size /= 4;
+	}
+
+	if (filter->param_image_histogram) {
+		if (!filter->stats_histogram)
+			filter->stats_histogram = gs_texrender_create(GS_R32F, GS_ZS_NONE);
+		render_image_histogram(filter->stats_histogram, texture);
+	}
+	gs_blend_state_pop();
+
+	if (!filter->param_image_avg_luma && !filter->param_image_min_max)
+		return;
+
+	// Read back the 1x1 level staged on the previous frame so the copy never stalls the pipeline.
+	const size_t current = filter->stats_frame & 1;
+	const size_t previous = current ^ 1;
+	if (!filter->stats_stagesurf[current])
+		filter->stats_stagesurf[current] = gs_stagesurface_create(1, 1, GS_RGBA32F);
+	gs_stage_texture(filter->stats_stagesurf[current], source);
+	filter->stats_staged[current] = true;
+	filter->stats_frame++;
+
+	uint8_t *data;
+	uint32_t linesize;
+	if (filter->stats_staged[previous] && gs_stagesurface_map(filter->stats_stagesurf[previous], &data, &linesize)) {
+		const float *stats = (const float *)data;
+		filter->image_avg_luma = stats[0];
+		vec2_set(&filter->image_min_max, stats[1], stats[2]);
+		gs_stagesurface_unmap(filter->stats_stagesurf[previous]);
+	}
+}
+
+// Interpolates from the parameter's value towards to's value, or its default value when to is NULL.
+static void set_param_lerp(struct effect_param_data *param, const struct effect_param_data *to, float f)
+{
+	switch (param->type) {
+	case GS_SHADER_PARAM_FLOAT: {
+		const double b = to ? to->value.f : param->default_value.f;
+		gs_effect_set_float(param->param, (float)b * f + (float)param->value.f * (1.0f - f));
+		break;
+	}
+	case GS_SHADER_PARAM_INT: {
+		const long long b = to ? to->value.i : param->default_value.i;
+		gs_effect_set_int(param->param, (int)((double)b * f + (double)param->value.i * (1.0f - f)));
+		break;
+	}
+	case GS_SHADER_PARAM_VEC2: {
+		struct vec2 a, v2;
+		vec2_mulf(&a, &param->value.vec2, 1.0f - f);
+		vec2_mulf(&v2, to ? &to->value.vec2 : &param->default_value.vec2, f);
+		vec2_add(&v2, &v2, &a);
+		gs_effect_set_vec2(param->param, &v2);
+		break;
+	}
+	case GS_SHADER_PARAM_VEC3: {
+		struct vec3 a, v3;
+		vec3_mulf(&a, &param->value.vec3, 1.0f - f);
+		vec3_mulf(&v3, to ? &to->value.vec3 : &param->default_value.vec3, f);
+		vec3_add(&v3, &v3, &a);
+		gs_effect_set_vec3(param->param, &v3);
+		break;
+	}
+	case GS_SHADER_PARAM_VEC4: {
+		struct vec4 a, v4;
+		vec4_mulf(&a, &param->value.vec4, 1.0f - f);
+		vec4_mulf(&v4, to ? &to->value.vec4 : &param->default_value.vec4, f);
+		vec4_add(&v4, &v4, &a);
+		gs_effect_set_vec4(param->param, &v4);
+		break;
+	}
+	default:;
+	}
+}
+
+// Matches parameters by name and type once per move-transition target instead of on every frame.
+static void update_lerp_pairs(struct shader_filter_data *filter, struct shader_filter_data *filter2)
+{
+	if (filter->lerp_target_id == filter2->trace_id && filter->lerp_generation == filter->effect_generation &&
+	    filter->lerp_target_generation == filter2->effect_generation)
+		return;
+	filter->lerp_target_id = filter2->trace_id;
+	filter->lerp_generation = filter->effect_generation;
+	filter->lerp_target_generation = filter2->effect_generation;
+
+	filter->lerp_pairs.num = 0;
+	for (size_t i = 0; i < filter->stored_param_list.num; i++) {
+		struct effect_param_data *param = (filter->stored_param_list.array + i);
+		if (!param->param)
+			continue;
+		for (size_t j = 0; j < filter2->stored_param_list.num; j++) {
+			struct effect_param_data *param2 = (filter2->stored_param_list.array + j);
+			if (!param2->param || param->type != param2->type || strcmp(param->name.array, param2->name.array) != 0)
+				continue;
+			struct param_pair pair = {i, j};
+			da_push_back(filter->lerp_pairs, &pair);
+			break;
+		}
+	}
+}
+
+static void set_image_history_params(struct shader_filter_data *filter)
+{
+	// Frames beyond a lowered depth are no longer part of the ring.
+	for (int i = filter->history_depth; i < IMAGE_HISTORY_MAX; i++)
+		destroy_texrender(&filter->history[i]);
+	if (filter->history_head >= filter->history_depth)
+		filter->history_head = 0;
+
+	for (int i = 0; i < filter->history_depth; i++) {
+		if (!filter->param_image_history[i])
+			continue;
+		const int slot = (filter->history_head - i + filter->history_depth) % filter->history_depth;
+		gs_effect_set_texture(filter->param_image_history[i], gs_texrender_get_texture(filter->history[slot]));
+	}
+}
+
+// Downscaled history can not reuse the input captures, so a reduced copy of the input goes into the ring instead.
+static void push_image_history(struct shader_filter_data *filter, gs_texture_t *texture)
+{
+	const uint32_t width = filter->input_width / filter->history_downscale;
+	const uint32_t height = filter->input_height / filter->history_downscale;
+	if (!width || !height)
+		return;
+
+	filter->history_head = (filter->history_head + 1) % filter->history_depth;
+	filter->history[filter->history_head] = create_or_reset_texrender(filter->history[filter->history_head]);
+
+	gs_effect_t *pass_through = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_enable_blending(false);
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	if (gs_texrender_begin(filter->history[filter->history_head], width, height)) {
+		gs_ortho(0.0f, (float)filter->total_width, 0.0f, (float)filter->total_height, -100.0f, 100.0f);
+		gs_effect_set_texture(gs_effect_get_param_by_name(pass_through, "image"), texture);
+		while (gs_effect_loop(pass_through, "Draw"))
+			gs_draw_sprite(texture, 0, filter->total_width, filter->total_height);
+		gs_texrender_end(filter->history[filter->history_head]);
+	}
+	gs_blend_state_pop();
+}
+
+// Draws the output quad with the current effect technique.
+static void draw_shader_quad(struct shader_filter_data *filter, gs_texture_t *texture)
+{
+	if (filter->use_template) {
+		gs_draw_sprite(texture, 0, filter->total_width, filter->total_height);
+		return;
+	}
+	if (!filter->sprite_buffer)
+		load_sprite_buffer(filter);
+
+	// The quad only changes with the output size.
+	if (filter->sprite_width != filter->total_width || filter->sprite_height != filter->total_height) {
+		struct gs_vb_data *data = gs_vertexbuffer_get_data(filter->sprite_buffer);
+		build_sprite_norm(data, (float)filter->total_width, (float)filter->total_height);
+		gs_vertexbuffer_flush(filter->sprite_buffer);
+		filter->sprite_width = filter->total_width;
+		filter->sprite_height = filter->total_height;
+	}
+	gs_load_vertexbuffer(filter->sprite_buffer);
+	gs_load_indexbuffer(NULL);
+	gs_draw(GS_TRISTRIP, 0, 0);
+}
+
+// Renders the output into tile_columns x tile_rows texrenders. Every tile draws the full quad with a projection
+// covering only its own area, so the shader sees the same uv, uv_offset and uv_scale values as in a single pass.
+static void render_shader_tiles(struct shader_filter_data *filter, gs_effect_t *effect, gs_texture_t *texture)
+{
+	const size_t count = (size_t)filter->tile_columns * (size_t)filter->tile_rows;
+	for (size_t i = count; i < filter->output_tiles.num; i++)
+		gs_texrender_destroy(filter->output_tiles.array[i]);
+	da_resize(filter->output_tiles, count);
+
+	for (int row = 0; row < filter->tile_rows; row++) {
+		for (int column = 0; column < filter->tile_columns; column++) {
+			gs_texrender_t **tile = filter->output_tiles.array + (size_t)row * filter->tile_columns + column;
+			const int x = column * filter->tile_extent;
+			const int y = row * filter->tile_extent;
+			const int cx = filter->total_width - x < filter->tile_extent ? filter->total_width - x : filter->tile_extent;
+			const int cy = filter->total_height - y < filter->tile_extent ? filter->total_height - y : filter->tile_extent;
+			*tile = create_or_reset_texrender(*tile);
+			if (!gs_texrender_begin(*tile, cx, cy))
+				continue;
+			gs_ortho((float)x, (float)(x + cx), (float)y, (float)(y + cy), -100.0f, 100.0f);
+			while (gs_effect_loop(effect, "Draw"))
+				draw_shader_quad(filter, texture);
+			gs_texrender_end(*tile);
+		}
+	}
+}
+
+static void render_shader(struct shader_filter_data *filter, float f, obs_source_t *filter_to)
+{
+	gs_texture_t *texture = gs_texrender_get_texture(filter->input_texrender);
+	if (!texture) {
+		return;
+	}
+	profile_start(render_shader_name);
+	const uint64_t trace_start = trace_begin();
+
+	if (filter->tiled) {
+		destroy_texrender(&filter->output_texrender);
+		destroy_texrender(&filter->previous_output_texrender);
+	} else {
+		for (size_t i = 0; i < filter->output_tiles.num; i++)
+			gs_texrender_destroy(filter->output_tiles.array[i]);
+		da_free(filter->output_tiles);
+		if (filter->param_previous_output) {
+			gs_texrender_t *temp = filter->output_texrender;
+			filter->output_texrender = filter->previous_output_texrender;
+			filter->previous_output_texrender = temp;
+		}
+		filter->output_texrender = create_or_reset_texrender(filter->output_texrender);
+	}
+
+	if (filter->param_image)
+		gs_effect_set_texture(filter->param_image, texture);
+	if (filter->param_previous_image)
+		gs_effect_set_texture(filter->param_previous_image,
+				      filter->history_depth && filter->history_downscale <= 1
+					      ? gs_texrender_get_texture(filter->history[filter->history_head])
+					      : gs_texrender_get_texture(filter->previous_input_texrender));
+	set_image_history_params(filter);
+	if (filter->param_previous_output)
+		gs_effect_set_texture(filter->param_previous_output, gs_texrender_get_texture(filter->previous_output_texrender));
+
+	render_image_stats(filter, texture);
+	gs_effect_t *effect = filter->effect;
+	if (filter->fuse_active) {
+		if (filter->fuse->param_image)
+			gs_effect_set_texture(filter->fuse->param_image, texture);
+		effect = shader_filter_set_fuse_params(filter);
+	} else {
+		shader_filter_set_effect_params(filter);
+	}
+
+	if (f > 0.0f) {
+		if (filter_to) {
+			struct shader_filter_data *filter2 = obs_obj_get_data(filter_to);
+			update_lerp_pairs(filter, filter2);
+			for (size_t i = 0; i < filter->lerp_pairs.num; i++) {
+				const struct param_pair *pair = filter->lerp_pairs.array + i;
+				set_param_lerp(filter->stored_param_list.array + pair->from, filter2->stored_param_list.array + pair->to,
+					       f);
+			}
 		} else {
 			for (size_t i = 0; i < filter->stored_param_list.num; i++) {
 				struct effect_param_data *param = (filter->stored_param_list.array + i);
 				if (!param->param || !param->has_default)
 					continue;
-
-				switch (param->type) {
-				case GS_SHADER_PARAM_FLOAT:
-					gs_effect_set_float(param->param,
-							    (float)param->default_value.f * f + (float)param->value.f * (1.0f - f));
-					break;
-				case GS_SHADER_PARAM_INT:
-					gs_effect_set_int(param->param, (int)((double)param->default_value.i * f +
-									      (double)param->value.i * (1.0f - f)));
-					break;
-				case GS_SHADER_PARAM_VEC2: {
-					struct vec2 v2;
-					v2.x = param->default_value.vec2.x * f + param->value.vec2.x * (1.0f - f);
-					v2.y = param->default_value.vec2.y * f + param->value.vec2.y * (1.0f - f);
-					gs_effect_set_vec2(param->param, &v2);
-					break;
-				}
-				case GS_SHADER_PARAM_VEC3: {
-					struct vec3 v3;
-					v3.x = param->default_value.vec3.x * f + param->value.vec3.x * (1.0f - f);
-					v3.y = param->default_value.vec3.y * f + param->value.vec3.y * (1.0f - f);
-					v3.z = param->default_value.vec3.z * f + param->value.vec3.z * (1.0f - f);
-					gs_effect_set_vec3(param->param, &v3);
-					break;
-				}
-				case GS_SHADER_PARAM_VEC4: {
-					struct vec4 v4;
-					v4.x = param->default_value.vec4.x * f + param->value.vec4.x * (1.0f - f);
-					v4.y = param->default_value.vec4.y * f + param->value.vec4.y * (1.0f - f);
-					v4.z = param->default_value.vec4.z * f + param->value.vec4.z * (1.0f - f);
-					v4.w = param->default_value.vec4.w * f + param->value.vec4.w * (1.0f - f);
-					gs_effect_set_vec4(param->param, &v4);
-					break;
-				}
-				default:;
-				}
+				set_param_lerp(param, NULL, f);
 			}
 		}
 	}
@@ -3221,27 +5932,25 @@ static void render_shader(struct shader_filter_data *filter, float f, obs_source
 	gs_enable_blending(false);
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
-	if (gs_texrender_begin(filter->output_texrender, filter->total_width, filter->total_height)) {
+	// Timed from here so the input chain and the sources bound to parameters are not counted, the caller ends the frame.
+	gpu_timer_begin_frame(filter);
+	gpu_timer_begin(filter, GPU_TIMER_SHADER);
+	if (filter->tiled) {
+		render_shader_tiles(filter, effect, texture);
+	} else if (gs_texrender_begin(filter->output_texrender, filter->total_width, filter->total_height)) {
 		gs_ortho(0.0f, (float)filter->total_width, 0.0f, (float)filter->total_height, -100.0f, 100.0f);
-		while (gs_effect_loop(filter->effect, "Draw")) {
-			if (filter->use_template) {
-				gs_draw_sprite(texture, 0, filter->total_width, filter->total_height);
-			} else {
-				if (!filter->sprite_buffer)
-					load_sprite_buffer(filter);
-
-				struct gs_vb_data *data = gs_vertexbuffer_get_data(filter->sprite_buffer);
-				build_sprite_norm(data, (float)filter->total_width, (float)filter->total_height);
-				gs_vertexbuffer_flush(filter->sprite_buffer);
-				gs_load_vertexbuffer(filter->sprite_buffer);
-				gs_load_indexbuffer(NULL);
-				gs_draw(GS_TRISTRIP, 0, 0);
-			}
-		}
+		while (gs_effect_loop(effect, "Draw"))
+			draw_shader_quad(filter, texture);
 		gs_texrender_end(filter->output_texrender);
 	}
+	gpu_timer_end(filter, GPU_TIMER_SHADER);
 
 	gs_blend_state_pop();
+
+	if (filter->history_depth && filter->history_downscale > 1)
+		push_image_history(filter, texture);
+	trace_end(render_shader_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+	profile_end(render_shader_name);
 }
 
 static void shader_filter_render(void *data, gs_effect_t *effect)
@@ -3249,30 +5958,50 @@ static void shader_filter_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 
 	struct shader_filter_data *filter = data;
+	filter->last_render_time = obs_get_video_frame_time();
 
 	float f = 0.0f;
 	obs_source_t *filter_to = NULL;
 	if (move_get_transition_filter)
 		f = move_get_transition_filter(filter->context, &filter_to);
 
+	// Already applied by a fused filter further up the chain this frame.
+	if (filter->fuse_time == obs_get_video_frame_time()) {
+		filter->frames_skipped++;
+		obs_source_skip_video_filter(filter->context);
+		return;
+	}
+
 	if (f == 0.0f && filter->output_rendered) {
+		const struct cpu_sample cpu = cpu_sample_begin();
 		draw_output(filter);
+		cpu_sample_end(filter, cpu);
 		return;
 	}
 
-	if (filter->effect == NULL || filter->rendering) {
+	// Compiling here would stall the graphics thread, the next tick compiles it now that it is rendered.
+	if (filter->compile_deferred || filter->effect == NULL || filter->rendering) {
+		filter->frames_skipped++;
 		obs_source_skip_video_filter(filter->context);
 		return;
 	}
 
+	const struct cpu_sample cpu = cpu_sample_begin();
+	shader_filter_update_fuse(filter, f);
 	get_input_source(filter);
 
 	filter->rendering = true;
 	render_shader(filter, f, filter_to);
+	output_capture_frame(filter);
+	gpu_timer_begin(filter, GPU_TIMER_OUTPUT);
 	draw_output(filter);
+	gpu_timer_end(filter, GPU_TIMER_OUTPUT);
+	gpu_timer_end_frame(filter);
+	filter->frames_rendered++;
 	if (f == 0.0f)
 		filter->output_rendered = true;
 	filter->rendering = false;
+	cpu_sample_end(filter, cpu);
 }
 
 static uint32_t shader_filter_getwidth(void *data)
@@ -3292,6 +6021,11 @@ static uint32_t shader_filter_getheight(void *data)
 static void shader_filter_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, "shader_text", effect_template_default_image_shader);
+	obs_data_set_default_int(settings, "audio_fft_size", 2048);
+	obs_data_set_default_int(settings, "audio_spectrum_bands", 64);
+	obs_data_set_default_bool(settings, "audio_spectrum_log", true);
+	obs_data_set_default_string(settings, "capture_format", "png");
+	obs_data_set_default_int(settings, "capture_interval", 1);
 }
 
 static enum gs_color_space shader_filter_get_color_space(void *data, size_t count, const enum gs_color_space *preferred_spaces)
@@ -3376,12 +6110,14 @@ static void *shader_transition_create(obs_data_t *settings, obs_source_t *source
 	dstr_init(&filter->last_path);
 	dstr_copy(&filter->last_path, obs_data_get_string(settings, "shader_file_name"));
 	filter->last_from_file = obs_data_get_bool(settings, "from_file");
-	filter->rand_instance_f = (float)((double)rand_interval(0, 10000) / (double)10000);
-	filter->rand_activation_f = (float)((double)rand_interval(0, 10000) / (double)10000);
+	filter->rand_instance_f = shader_filter_random(filter);
+	filter->rand_activation_f = shader_filter_random(filter);
 
+	filter->trace_id = os_atomic_inc_long(&trace_next_instance);
 	da_init(filter->stored_param_list);
 
-	obs_source_update(source, settings);
+	shader_filter_initial_update(filter, settings);
+	filter_registry_add(filter);
 
 	return filter;
 }
@@ -3419,6 +6155,8 @@ static void shader_transition_video_callback(void *data, gs_texture_t *a, gs_tex
 	struct shader_filter_data *filter = data;
 	if (filter->effect == NULL || filter->rendering)
 		return;
+	profile_start(transition_render_name);
+	const uint64_t trace_start = trace_begin();
 
 	if (!filter->prev_transitioning) {
 		if (obs_source_active(filter->context))
@@ -3455,10 +6193,17 @@ static void shader_transition_video_callback(void *data, gs_texture_t *a, gs_tex
 
 	shader_filter_set_effect_params(filter);
 
+	gpu_timer_begin_frame(filter);
+	gpu_timer_begin(filter, GPU_TIMER_SHADER);
 	while (gs_effect_loop(filter->effect, "Draw"))
 		gs_draw_sprite(NULL, 0, cx, cy);
+	gpu_timer_end(filter, GPU_TIMER_SHADER);
+	gpu_timer_end_frame(filter);
+	filter->frames_rendered++;
 
 	gs_enable_framebuffer_srgb(previous);
+	trace_end(transition_render_name, filter->trace_id, TRACE_THREAD_GRAPHICS, trace_start);
+	profile_end(transition_render_name);
 }
 
 static void shader_transition_video_render(void *data, gs_effect_t *effect)
@@ -3469,6 +6214,7 @@ static void shader_transition_video_render(void *data, gs_effect_t *effect)
 
 	struct shader_filter_data *filter = data;
 	filter->transitioning = false;
+	const struct cpu_sample cpu = cpu_sample_begin();
 	obs_transition_video_render2(filter->context, shader_transition_video_callback, NULL);
 	if (!filter->transitioning && filter->prev_transitioning) {
 		if (obs_source_active(filter->context))
@@ -3477,12 +6223,16 @@ static void shader_transition_video_render(void *data, gs_effect_t *effect)
 			shader_filter_param_source_action(data, obs_source_dec_showing);
 	}
 	filter->prev_transitioning = filter->transitioning;
+	cpu_sample_end(filter, cpu);
 	gs_set_linear_srgb(previous);
 }
 
 static void shader_transition_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, "shader_text", effect_template_default_transition_image_shader);
+	obs_data_set_default_int(settings, "audio_fft_size", 2048);
+	obs_data_set_default_int(settings, "audio_spectrum_bands", 64);
+	obs_data_set_default_bool(settings, "audio_spectrum_log", true);
 }
 
 static enum gs_color_space shader_transition_get_color_space(void *data, size_t count, const enum gs_color_space *preferred_spaces)
@@ -3519,16 +6269,1080 @@ struct obs_source_info shader_transition = {
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-shaderfilter", "en-US")
 
+// Proc handler: void shader_filter_get_stats(out string json)
+static void shader_filter_get_stats_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	obs_data_t *root = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+
+	// The registry lock keeps the filters alive, their snapshots are replaced under filter_stats_mutex.
+	uint64_t filter_vram = 0;
+	pthread_mutex_lock(&filter_registry_mutex);
+	pthread_mutex_lock(&filter_stats_mutex);
+	for (size_t i = 0; i < filter_registry.num; i++) {
+		struct shader_filter_data *filter = filter_registry.array[i];
+		if (!filter->stats_snapshot)
+			continue;
+		obs_data_array_push_back(filters, filter->stats_snapshot);
+		filter_vram += filter->stats_snapshot_vram;
+	}
+	pthread_mutex_unlock(&filter_stats_mutex);
+	pthread_mutex_unlock(&filter_registry_mutex);
+
+	// Images are shared between filters, so they are counted once here instead of per filter.
+	uint64_t image_vram = 0;
+	obs_enter_graphics();
+	pthread_mutex_lock(&image_cache_mutex);
+	for (struct image_cache_entry *entry = image_cache; entry; entry = entry->next)
+		image_vram += image_cache_entry_vram(entry);
+	pthread_mutex_unlock(&image_cache_mutex);
+	obs_leave_graphics();
+
+	obs_data_t *vram = obs_data_create();
+	obs_data_set_int(vram, "used_bytes", (long long)(filter_vram + image_vram));
+	obs_data_set_int(vram, "image_bytes", (long long)image_vram);
+	obs_data_set_int(vram, "budget_bytes", (long long)vram_budget);
+	obs_data_set_int(vram, "image_evictions", os_atomic_load_long(&vram_image_evictions));
+	obs_data_set_int(vram, "texture_evictions", os_atomic_load_long(&vram_texture_evictions));
+	obs_data_set_obj(root, "vram", vram);
+	obs_data_release(vram);
+	obs_data_set_array(root, "filters", filters);
+	obs_data_array_release(filters);
+
+	pthread_mutex_lock(&image_cache_mutex);
+	long long image_count = 0;
+	for (struct image_cache_entry *entry = image_cache; entry; entry = entry->next)
+		image_count++;
+	pthread_mutex_unlock(&image_cache_mutex);
+	obs_data_set_int(root, "image_cache_entries", image_count);
+	// bmalloc counts the allocations of the whole process, not of the shader filters.
+	obs_data_set_int(root, "process_allocs", bnum_allocs());
+
+	calldata_set_string(cd, "json", obs_data_get_json(root));
+	obs_data_release(root);
+}
+
+// Graphics context held. Filters rendered without a parent by the benchmarks and batch render get their input from a
+// texture instead of get_input_source.
+static void offline_draw_input(struct shader_filter_data *filter, gs_texture_t *texture, uint32_t cx, uint32_t cy)
+{
+	shader_filter_set_size(filter, (int)cx, (int)cy);
+	gs_effect_t *pass_through = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	filter->input_texrender = create_or_reset_texrender(filter->input_texrender);
+	if (gs_texrender_begin(filter->input_texrender, filter->total_width, filter->total_height)) {
+		gs_ortho(0.0f, (float)filter->total_width, 0.0f, (float)filter->total_height, -100.0f, 100.0f);
+		gs_matrix_push();
+		gs_matrix_translate3f((float)filter->expand_left, (float)filter->expand_top, 0.0f);
+		gs_effect_set_texture(gs_effect_get_param_by_name(pass_through, "image"), texture);
+		while (gs_effect_loop(pass_through, "Draw"))
+			gs_draw_sprite(texture, 0, cx, cy);
+		gs_matrix_pop();
+		gs_texrender_end(filter->input_texrender);
+	}
+}
+
+// The time keeping of shader_filter_tick, with a fixed time step and elapsed_time as local_time.
+static void offline_advance_time(struct shader_filter_data *filter, float seconds)
+{
+	if (filter->shader_start_time == 0.0f)
+		filter->shader_start_time = filter->elapsed_time + seconds;
+	filter->elapsed_time += seconds;
+	filter->elapsed_time_loop += seconds;
+	if (filter->elapsed_time_loop > 1.0f) {
+		filter->elapsed_time_loop -= 1.0f;
+		filter->loops++;
+	}
+	filter->shader_show_time += seconds;
+	filter->shader_active_time += seconds;
+	filter->local_time = filter->elapsed_time;
+}
+
+#define BENCHMARK_WARMUP_FRAMES 5
+#define BENCHMARK_NOISE_MS 0.05
+
+struct benchmark_size {
+	uint32_t cx;
+	uint32_t cy;
+	gs_texture_t *input_a;
+	gs_texture_t *input_b;
+};
+
+// Gradient with a checkerboard, so the input is neither flat nor trivially compressible.
+static gs_texture_t *benchmark_create_input(uint32_t cx, uint32_t cy, bool invert)
+{
+	uint8_t *data = bmalloc((size_t)cx * cy * 4);
+	for (uint32_t y = 0; y < cy; y++) {
+		for (uint32_t x = 0; x < cx; x++) {
+			uint8_t *pixel = data + ((size_t)y * cx + x) * 4;
+			const bool check = ((x / 32 + y / 32) & 1) != invert;
+			pixel[0] = (uint8_t)(x * 255 / cx);
+			pixel[1] = (uint8_t)(y * 255 / cy);
+			pixel[2] = check ? 255 : 0;
+			pixel[3] = 255;
+		}
+	}
+	const uint8_t *levels[1] = {data};
+	gs_texture_t *texture = gs_texture_create(cx, cy, GS_RGBA, 1, levels, 0);
+	bfree(data);
+	return texture;
+}
+
+static int benchmark_compare(const void *a, const void *b)
+{
+	const double x = *(const double *)a;
+	const double y = *(const double *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Graphics context held. Returns the median GPU time per frame in ms, or -1 when timer queries are unavailable.
+// cpu_us receives the average CPU time per frame spent submitting the work.
+static double benchmark_render(struct shader_filter_data *filter, const struct benchmark_size *size, int frames,
+			       double *cpu_us)
+{
+	if (filter->transition)
+		shader_filter_set_size(filter, (int)size->cx, (int)size->cy);
+	else
+		offline_draw_input(filter, size->input_a, size->cx, size->cy);
+
+	gs_timer_range_t *range = gs_timer_range_create();
+	gs_timer_t **timers = bzalloc(sizeof(gs_timer_t *) * frames);
+	for (int i = 0; range && i < frames; i++)
+		timers[i] = gs_timer_create();
+	if (range)
+		gs_timer_range_begin(range);
+	// The benchmark times the frames itself, the filter's own timer would nest in its range.
+	gpu_timer_range_open = true;
+	uint64_t cpu_start = 0;
+	for (int i = 0; i < BENCHMARK_WARMUP_FRAMES + frames; i++) {
+		gs_timer_t *timer = i >= BENCHMARK_WARMUP_FRAMES ? timers[i - BENCHMARK_WARMUP_FRAMES] : NULL;
+		if (i == BENCHMARK_WARMUP_FRAMES)
+			cpu_start = os_gettime_ns();
+		filter->elapsed_time += 1.0f / 60.0f;
+		if (timer)
+			gs_timer_begin(timer);
+		if (filter->transition) {
+			filter->output_texrender = create_or_reset_texrender(filter->output_texrender);
+			if (gs_texrender_begin(filter->output_texrender, size->cx, size->cy)) {
+				gs_ortho(0.0f, (float)size->cx, 0.0f, (float)size->cy, -100.0f, 100.0f);
+				shader_transition_video_callback(filter, size->input_a, size->input_b, 0.5f, size->cx, size->cy);
+				gs_texrender_end(filter->output_texrender);
+			}
+		} else {
+			render_shader(filter, 0.0f, NULL);
+		}
+		if (timer)
+			gs_timer_end(timer);
+	}
+	*cpu_us = (double)(os_gettime_ns() - cpu_start) / 1000.0 / frames;
+	if (range)
+		gs_timer_range_end(range);
+	gpu_timer_range_open = false;
+
+	double result = -1.0;
+	bool disjoint = true;
+	uint64_t frequency = 0;
+	for (int tries = 0; range && tries < 2000; tries++) {
+		gs_flush();
+		if (gs_timer_range_get_data(range, &disjoint, &frequency))
+			break;
+		os_sleep_ms(1);
+	}
+	if (range && !disjoint && frequency) {
+		double *samples = bmalloc(sizeof(double) * frames);
+		int count = 0;
+		for (int i = 0; i < frames; i++) {
+			uint64_t ticks;
+			if (timers[i] && gs_timer_get_data(timers[i], &ticks))
+				samples[count++] = (double)ticks * 1000.0 / (double)frequency;
+		}
+		if (count) {
+			qsort(samples, count, sizeof(double), benchmark_compare);
+			result = samples[count / 2];
+		}
+		bfree(samples);
+	}
+	for (int i = 0; i < frames; i++)
+		gs_timer_destroy(timers[i]);
+	bfree(timers);
+	gs_timer_range_destroy(range);
+	return result;
+}
+
+static obs_data_t *benchmark_shader(const char *path, struct benchmark_size *sizes, size_t size_count, int frames)
+{
+	const char *file_name = strrchr(path, '/');
+	file_name = file_name ? file_name + 1 : path;
+	const bool transition = astrstri(file_name, "transition") != NULL;
+	const char *extension = strrchr(file_name, '.');
+
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_bool(settings, "from_file", true);
+	obs_data_set_string(settings, "shader_file_name", path);
+	obs_data_set_bool(settings, "override_entire_effect", extension && astrcmpi(extension, ".effect") == 0);
+	obs_data_set_bool(settings, "offline", true);
+	const uint64_t start = os_gettime_ns();
+	obs_source_t *source =
+		obs_source_create_private(transition ? "shader_transition" : "shader_filter", "shader benchmark", settings);
+	struct shader_filter_data *filter = source ? obs_obj_get_data(source) : NULL;
+	const uint64_t create_ns = os_gettime_ns() - start;
+	obs_data_release(settings);
+
+	obs_data_t *result = obs_data_create();
+	obs_data_set_string(result, "shader", file_name);
+	obs_data_set_string(result, "type", transition ? "transition" : "filter");
+	obs_data_set_bool(result, "compiled", filter && filter->effect);
+	if (!filter || !filter->effect) {
+		obs_source_release(source);
+		return result;
+	}
+	obs_data_set_double(result, "compile_ms", (double)filter->compile_time_ns / 1000000.0);
+	obs_data_set_double(result, "create_ms", (double)create_ns / 1000000.0);
+
+	obs_data_array_t *frame_times = obs_data_array_create();
+	for (size_t i = 0; i < size_count; i++) {
+		double cpu_us = 0.0;
+		obs_enter_graphics();
+		const double gpu_ms = benchmark_render(filter, sizes + i, frames, &cpu_us);
+		obs_leave_graphics();
+
+		obs_data_t *item = obs_data_create();
+		obs_data_set_int(item, "width", sizes[i].cx);
+		obs_data_set_int(item, "height", sizes[i].cy);
+		obs_data_set_double(item, "gpu_ms", gpu_ms);
+		obs_data_set_double(item, "cpu_us", cpu_us);
+		obs_data_array_push_back(frame_times, item);
+		obs_data_release(item);
+	}
+	obs_data_set_array(result, "frame_times", frame_times);
+	obs_data_array_release(frame_times);
+	obs_source_release(source);
+	return result;
+}
+
+static double benchmark_find_baseline(obs_data_array_t *baseline, const char *shader, long long cx, long long cy)
+{
+	double gpu_ms = -1.0;
+	const size_t count = baseline ? obs_data_array_count(baseline) : 0;
+	for (size_t i = 0; i < count && gpu_ms < 0.0; i++) {
+		obs_data_t *item = obs_data_array_item(baseline, i);
+		if (strcmp(obs_data_get_string(item, "shader"), shader) == 0) {
+			obs_data_array_t *frame_times = obs_data_get_array(item, "frame_times");
+			const size_t frame_count = frame_times ? obs_data_array_count(frame_times) : 0;
+			for (size_t j = 0; j < frame_count; j++) {
+				obs_data_t *frame = obs_data_array_item(frame_times, j);
+				if (obs_data_get_int(frame, "width") == cx && obs_data_get_int(frame, "height") == cy)
+					gpu_ms = obs_data_get_double(frame, "gpu_ms");
+				obs_data_release(frame);
+			}
+			obs_data_array_release(frame_times);
+		}
+		obs_data_release(item);
+	}
+	return gpu_ms;
+}
+
+// Adds the name of every shader that did not compile or could not be timed. Returns true when there are none and at
+// least one shader ran.
+static bool benchmark_check_results(obs_data_array_t *shaders, obs_data_array_t *failures)
+{
+	const size_t count = obs_data_array_count(shaders);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(shaders, i);
+		bool failed = !obs_data_get_bool(item, "compiled");
+		obs_data_array_t *frame_times = obs_data_get_array(item, "frame_times");
+		const size_t frame_count = frame_times ? obs_data_array_count(frame_times) : 0;
+		for (size_t j = 0; j < frame_count; j++) {
+			obs_data_t *frame = obs_data_array_item(frame_times, j);
+			failed |= obs_data_get_double(frame, "gpu_ms") < 0.0;
+			obs_data_release(frame);
+		}
+		obs_data_array_release(frame_times);
+		if (failed) {
+			obs_data_t *failure = obs_data_create();
+			obs_data_set_string(failure, "shader", obs_data_get_string(item, "shader"));
+			obs_data_array_push_back(failures, failure);
+			obs_data_release(failure);
+		}
+		obs_data_release(item);
+	}
+	return count && !obs_data_array_count(failures);
+}
+
+// Adds a regression for every frame time that got slower than baseline * threshold. Returns true when there are none.
+static bool benchmark_compare_baseline(obs_data_array_t *shaders, obs_data_array_t *baseline, double threshold,
+				       obs_data_array_t *regressions)
+{
+	bool passed = true;
+	for (size_t i = 0; i < obs_data_array_count(shaders); i++) {
+		obs_data_t *shader = obs_data_array_item(shaders, i);
+		const char *name = obs_data_get_string(shader, "shader");
+		obs_data_array_t *frame_times = obs_data_get_array(shader, "frame_times");
+		const size_t frame_count = frame_times ? obs_data_array_count(frame_times) : 0;
+		for (size_t j = 0; j < frame_count; j++) {
+			obs_data_t *frame = obs_data_array_item(frame_times, j);
+			const long long cx = obs_data_get_int(frame, "width");
+			const long long cy = obs_data_get_int(frame, "height");
+			const double gpu_ms = obs_data_get_double(frame, "gpu_ms");
+			const double baseline_ms = benchmark_find_baseline(baseline, name, cx, cy);
+			if (baseline_ms >= 0.0 && gpu_ms > baseline_ms * threshold && gpu_ms - baseline_ms > BENCHMARK_NOISE_MS) {
+				obs_data_t *regression = obs_data_create();
+				obs_data_set_string(regression, "shader", name);
+				obs_data_set_int(regression, "width", cx);
+				obs_data_set_int(regression, "height", cy);
+				obs_data_set_double(regression, "baseline_ms", baseline_ms);
+				obs_data_set_double(regression, "gpu_ms", gpu_ms);
+				obs_data_array_push_back(regressions, regression);
+				obs_data_release(regression);
+				blog(LOG_WARNING, "[obs-shaderfilter] Benchmark regression: %s at %lldx%lld took %.3f ms, baseline %.3f ms",
+				     name, cx, cy, gpu_ms, baseline_ms);
+				passed = false;
+			}
+			obs_data_release(frame);
+		}
+		obs_data_array_release(frame_times);
+		obs_data_release(shader);
+	}
+	return passed;
+}
+
+static volatile bool benchmark_running = false;
+
+// Runs for minutes, so it has its own thread and reports through the shader_filter_benchmark_done signal.
+static void *benchmark_thread(void *data)
+{
+	obs_data_t *options = data;
+	os_set_thread_name("shaderfilter: benchmark");
+	obs_data_set_default_int(options, "frames", 60);
+	obs_data_set_default_double(options, "threshold", 1.2);
+	const int frames = (int)obs_data_get_int(options, "frames") > 0 ? (int)obs_data_get_int(options, "frames") : 1;
+	const char *name_filter = obs_data_get_string(options, "filter");
+
+	DARRAY(struct benchmark_size) sizes;
+	da_init(sizes);
+	obs_data_array_t *resolutions = obs_data_get_array(options, "resolutions");
+	for (size_t i = 0; resolutions && i < obs_data_array_count(resolutions); i++) {
+		obs_data_t *item = obs_data_array_item(resolutions, i);
+		struct benchmark_size *size = da_push_back_new(sizes);
+		size->cx = (uint32_t)obs_data_get_int(item, "width");
+		size->cy = (uint32_t)obs_data_get_int(item, "height");
+		if (!size->cx || !size->cy)
+			da_pop_back(sizes);
+		obs_data_release(item);
+	}
+	obs_data_array_release(resolutions);
+	if (!sizes.num) {
+		const uint32_t defaults[][2] = {{640, 360}, {1280, 720}, {1920, 1080}};
+		for (size_t i = 0; i < OBS_COUNTOF(defaults); i++) {
+			struct benchmark_size *size = da_push_back_new(sizes);
+			size->cx = defaults[i][0];
+			size->cy = defaults[i][1];
+		}
+	}
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < sizes.num; i++) {
+		sizes.array[i].input_a = benchmark_create_input(sizes.array[i].cx, sizes.array[i].cy, false);
+		sizes.array[i].input_b = benchmark_create_input(sizes.array[i].cx, sizes.array[i].cy, true);
+	}
+	obs_leave_graphics();
+
+	struct dstr pattern = {0};
+	dstr_copy(&pattern, obs_get_module_data_path(obs_current_module()));
+	dstr_cat(&pattern, "/examples/*.*");
+	obs_data_array_t *shaders = obs_data_array_create();
+	os_glob_t *glob;
+	if (os_glob(pattern.array, 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++) {
+			const char *path = glob->gl_pathv[i].path;
+			const char *extension = strrchr(path, '.');
+			if (glob->gl_pathv[i].directory || !extension ||
+			    (astrcmpi(extension, ".shader") != 0 && astrcmpi(extension, ".effect") != 0))
+				continue;
+			if (*name_filter && !astrstri(path, name_filter))
+				continue;
+			obs_data_t *result = benchmark_shader(path, sizes.array, sizes.num, frames);
+			obs_data_array_push_back(shaders, result);
+			obs_data_release(result);
+		}
+		os_globfree(glob);
+	}
+	dstr_free(&pattern);
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < sizes.num; i++) {
+		gs_texture_destroy(sizes.array[i].input_a);
+		gs_texture_destroy(sizes.array[i].input_b);
+	}
+	obs_leave_graphics();
+	da_free(sizes);
+
+	obs_data_t *report = obs_data_create();
+	obs_data_set_string(report, "version", PROJECT_VERSION);
+	obs_data_set_int(report, "frames", frames);
+	obs_data_set_array(report, "shaders", shaders);
+
+	obs_data_array_t *failures = obs_data_array_create();
+	bool passed = benchmark_check_results(shaders, failures);
+	obs_data_set_array(report, "failures", failures);
+	obs_data_array_release(failures);
+	const char *baseline_path = obs_data_get_string(options, "baseline");
+	obs_data_t *baseline = *baseline_path ? obs_data_create_from_json_file(baseline_path) : NULL;
+	if (baseline) {
+		obs_data_array_t *baseline_shaders = obs_data_get_array(baseline, "shaders");
+		obs_data_array_t *regressions = obs_data_array_create();
+		passed &= benchmark_compare_baseline(shaders, baseline_shaders, obs_data_get_double(options, "threshold"),
+						     regressions);
+		obs_data_set_array(report, "regressions", regressions);
+		obs_data_array_release(regressions);
+		obs_data_array_release(baseline_shaders);
+		obs_data_release(baseline);
+	} else if (*baseline_path) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Unable to read benchmark baseline %s", baseline_path);
+		passed = false;
+	}
+	obs_data_set_bool(report, "passed", passed);
+
+	struct calldata cd;
+	calldata_init(&cd);
+	char *path = make_output_path("benchmarks", "benchmark");
+	if (path && obs_data_save_json(report, path)) {
+		blog(LOG_INFO, "[obs-shaderfilter] Benchmarked %zu shaders, results written to %s",
+		     obs_data_array_count(shaders), path);
+		calldata_set_string(&cd, "path", path);
+	} else {
+		calldata_set_string(&cd, "path", "");
+	}
+	calldata_set_bool(&cd, "passed", passed);
+	signal_handler_signal(obs_get_signal_handler(), "shader_filter_benchmark_done", &cd);
+	calldata_free(&cd);
+	bfree(path);
+	obs_data_array_release(shaders);
+	obs_data_release(report);
+	obs_data_release(options);
+	os_atomic_set_bool(&benchmark_running, false);
+	return NULL;
+}
+
+// Proc handler: void shader_filter_benchmark(in string options, out bool started)
+// Options (JSON, all optional): {"filter": "name part", "frames": 60, "resolutions": [{"width": 1920, "height": 1080}],
+// "baseline": "previous result.json", "threshold": 1.2}
+// Returns right away, started is false while another benchmark is still running. The result is signalled as
+// void shader_filter_benchmark_done(string path, bool passed) on the global signal handler.
+static void shader_filter_benchmark_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	if (os_atomic_set_bool(&benchmark_running, true)) {
+		calldata_set_bool(cd, "started", false);
+		return;
+	}
+	const char *options_json = calldata_string(cd, "options");
+	obs_data_t *options = options_json && *options_json ? obs_data_create_from_json(options_json) : NULL;
+	if (!options)
+		options = obs_data_create();
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, benchmark_thread, options) == 0) {
+		pthread_detach(thread);
+		calldata_set_bool(cd, "started", true);
+	} else {
+		blog(LOG_ERROR, "[obs-shaderfilter] Unable to start benchmark thread");
+		obs_data_release(options);
+		os_atomic_set_bool(&benchmark_running, false);
+		calldata_set_bool(cd, "started", false);
+	}
+}
+
+// Many instances of one shader driven the way the video thread drives them, for the CPU overhead per instance. Every
+// frame each instance advances its time, draws its input and renders; every update_interval frames it also runs a
+// settings update. The graphics context is held for each frame, so OBS does not render meanwhile.
+static bool instance_benchmark(obs_data_t *options, obs_data_t *report)
+{
+	obs_data_set_default_string(options, "shader", "Invert.shader");
+	obs_data_set_default_int(options, "instances", 500);
+	obs_data_set_default_int(options, "frames", 120);
+	obs_data_set_default_int(options, "update_interval", 60);
+	obs_data_set_default_int(options, "width", 320);
+	obs_data_set_default_int(options, "height", 180);
+	const char *shader = obs_data_get_string(options, "shader");
+	const long long count = obs_data_get_int(options, "instances") > 0 ? obs_data_get_int(options, "instances") : 1;
+	const int frames = (int)obs_data_get_int(options, "frames") > 0 ? (int)obs_data_get_int(options, "frames") : 1;
+	const int update_interval = (int)obs_data_get_int(options, "update_interval");
+	const uint32_t cx = obs_data_get_int(options, "width") > 0 ? (uint32_t)obs_data_get_int(options, "width") : 320;
+	const uint32_t cy = obs_data_get_int(options, "height") > 0 ? (uint32_t)obs_data_get_int(options, "height") : 180;
+
+	struct dstr path = {0};
+	dstr_copy(&path, obs_get_module_data_path(obs_current_module()));
+	dstr_cat(&path, "/examples/");
+	dstr_cat(&path, shader);
+	obs_data_t *settings = obs_data_create();
+	const char *extension = strrchr(shader, '.');
+	obs_data_set_bool(settings, "from_file", true);
+	obs_data_set_string(settings, "shader_file_name", path.array);
+	obs_data_set_bool(settings, "override_entire_effect", extension && astrcmpi(extension, ".effect") == 0);
+	obs_data_set_bool(settings, "offline", true);
+	dstr_free(&path);
+
+	DARRAY(obs_source_t *) sources;
+	da_init(sources);
+	const uint64_t create_start = os_gettime_ns();
+	bool compiled = true;
+	for (long long i = 0; i < count; i++) {
+		obs_source_t *source = obs_source_create_private("shader_filter", "shader instance benchmark", settings);
+		struct shader_filter_data *filter = source ? obs_obj_get_data(source) : NULL;
+		if (!filter || !filter->effect) {
+			compiled = false;
+			obs_source_release(source);
+			break;
+		}
+		da_push_back(sources, &source);
+	}
+	const uint64_t create_ns = os_gettime_ns() - create_start;
+	obs_data_release(settings);
+
+	obs_data_set_string(report, "shader", shader);
+	obs_data_set_int(report, "instances", count);
+	obs_data_set_int(report, "frames", frames);
+	obs_data_set_int(report, "update_interval", update_interval);
+	obs_data_set_int(report, "width", cx);
+	obs_data_set_int(report, "height", cy);
+	obs_data_set_bool(report, "compiled", compiled);
+	if (!compiled) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Instance benchmark could not load shader %s", shader);
+		for (size_t i = 0; i < sources.num; i++)
+			obs_source_release(sources.array[i]);
+		da_free(sources);
+		return false;
+	}
+	obs_data_set_double(report, "create_ms", (double)create_ns / 1000000.0 / (double)count);
+
+	obs_enter_graphics();
+	gs_texture_t *input = benchmark_create_input(cx, cy, false);
+	obs_leave_graphics();
+
+	// The samples of each instance add up in its CPU stats window, which is only reset once the warmup is over.
+	uint64_t frames_start = 0;
+	for (int frame = 0; frame < BENCHMARK_WARMUP_FRAMES + frames; frame++) {
+		if (frame == BENCHMARK_WARMUP_FRAMES) {
+			for (size_t i = 0; i < sources.num; i++) {
+				struct shader_filter_data *filter = obs_obj_get_data(sources.array[i]);
+				filter->cpu_window_ns = 0;
+				filter->cpu_window_allocs = 0;
+			}
+			frames_start = os_gettime_ns();
+		}
+		const bool update = update_interval > 0 && (frame + 1) % update_interval == 0;
+		obs_enter_graphics();
+		for (size_t i = 0; i < sources.num; i++) {
+			struct shader_filter_data *filter = obs_obj_get_data(sources.array[i]);
+			const struct cpu_sample cpu = cpu_sample_begin();
+			if (update) {
+				obs_data_t *filter_settings = obs_source_get_settings(filter->context);
+				shader_filter_update(filter, filter_settings);
+				obs_data_release(filter_settings);
+			}
+			offline_advance_time(filter, 1.0f / 60.0f);
+			offline_draw_input(filter, input, cx, cy);
+			render_shader(filter, 0.0f, NULL);
+			cpu_sample_end(filter, cpu);
+		}
+		obs_leave_graphics();
+	}
+	const uint64_t frames_ns = os_gettime_ns() - frames_start;
+
+	obs_data_array_t *per_instance = obs_data_array_create();
+	double cpu_us_sum = 0.0;
+	double cpu_us_max = 0.0;
+	double allocs_sum = 0.0;
+	for (size_t i = 0; i < sources.num; i++) {
+		struct shader_filter_data *filter = obs_obj_get_data(sources.array[i]);
+		const double cpu_us = (double)filter->cpu_window_ns / 1000.0 / frames;
+		const double allocs = (double)filter->cpu_window_allocs / frames;
+		cpu_us_sum += cpu_us;
+		allocs_sum += allocs;
+		if (cpu_us > cpu_us_max)
+			cpu_us_max = cpu_us;
+		obs_data_t *item = obs_data_create();
+		obs_data_set_double(item, "cpu_us_per_frame", cpu_us);
+		if (alloc_counter)
+			obs_data_set_double(item, "allocs_per_frame", allocs);
+		obs_data_array_push_back(per_instance, item);
+		obs_data_release(item);
+	}
+	obs_data_set_double(report, "frame_ms", (double)frames_ns / 1000000.0 / frames);
+	obs_data_set_double(report, "cpu_us_per_frame", cpu_us_sum / (double)sources.num);
+	obs_data_set_double(report, "cpu_us_per_frame_max", cpu_us_max);
+	if (alloc_counter)
+		obs_data_set_double(report, "allocs_per_frame", allocs_sum / (double)sources.num);
+	obs_data_set_array(report, "per_instance", per_instance);
+	obs_data_array_release(per_instance);
+
+	obs_enter_graphics();
+	gs_texture_destroy(input);
+	obs_leave_graphics();
+	for (size_t i = 0; i < sources.num; i++)
+		obs_source_release(sources.array[i]);
+	blog(LOG_INFO, "[obs-shaderfilter] Instance benchmark of %lld x %s: %.1f us CPU per instance and frame", count, shader,
+	     cpu_us_sum / (double)sources.num);
+	da_free(sources);
+	return true;
+}
+
+static void *instance_benchmark_thread(void *data)
+{
+	obs_data_t *options = data;
+	os_set_thread_name("shaderfilter: instance benchmark");
+	obs_data_t *report = obs_data_create();
+	obs_data_set_string(report, "version", PROJECT_VERSION);
+	const bool passed = instance_benchmark(options, report);
+	obs_data_set_bool(report, "passed", passed);
+
+	struct calldata cd;
+	calldata_init(&cd);
+	char *path = make_output_path("benchmarks", "instances");
+	if (path && obs_data_save_json(report, path)) {
+		blog(LOG_INFO, "[obs-shaderfilter] Instance benchmark results written to %s", path);
+		calldata_set_string(&cd, "path", path);
+	} else {
+		calldata_set_string(&cd, "path", "");
+	}
+	calldata_set_bool(&cd, "passed", passed);
+	signal_handler_signal(obs_get_signal_handler(), "shader_filter_instance_benchmark_done", &cd);
+	calldata_free(&cd);
+	bfree(path);
+	obs_data_release(report);
+	obs_data_release(options);
+	os_atomic_set_bool(&benchmark_running, false);
+	return NULL;
+}
+
+// Proc handler: void shader_filter_instance_benchmark(in string options, out bool started)
+// Options (JSON, all optional): {"shader": "Invert.shader", "instances": 500, "frames": 120, "update_interval": 60,
+// "width": 320, "height": 180}
+// Shares benchmark_running with shader_filter_benchmark. The result is signalled as
+// void shader_filter_instance_benchmark_done(string path, bool passed) on the global signal handler.
+static void shader_filter_instance_benchmark_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	if (os_atomic_set_bool(&benchmark_running, true)) {
+		calldata_set_bool(cd, "started", false);
+		return;
+	}
+	const char *options_json = calldata_string(cd, "options");
+	obs_data_t *options = options_json && *options_json ? obs_data_create_from_json(options_json) : NULL;
+	if (!options)
+		options = obs_data_create();
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, instance_benchmark_thread, options) == 0) {
+		pthread_detach(thread);
+		calldata_set_bool(cd, "started", true);
+	} else {
+		blog(LOG_ERROR, "[obs-shaderfilter] Unable to start instance benchmark thread");
+		obs_data_release(options);
+		os_atomic_set_bool(&benchmark_running, false);
+		calldata_set_bool(cd, "started", false);
+	}
+}
+
+// Proc handler: void shader_filter_set_alloc_counter(in ptr counter)
+// counter points to a long long (*)(void) that returns the number of allocations made so far on the calling thread,
+// e.g. counted by an allocator installed with base_set_allocator. Only the first call counts and it has to come before
+// any filter is created, see alloc_counter.
+static void shader_filter_set_alloc_counter_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	long long (**counter)(void) = calldata_ptr(cd, "counter");
+	if (!counter || !*counter || alloc_counter)
+		return;
+	pthread_mutex_lock(&filter_registry_mutex);
+	if (filter_registry.num)
+		blog(LOG_WARNING, "[obs-shaderfilter] The allocation counter has to be set before any filter is created");
+	else
+		alloc_counter = *counter;
+	pthread_mutex_unlock(&filter_registry_mutex);
+}
+
+// Offline batch rendering: decoding, rendering and encoding run as a pipeline. A decoder thread reads the input images
+// into BATCH_QUEUE slots ahead of the renderer, the batch render thread renders them through a private filter, and the
+// output capture worker encodes the results.
+#define BATCH_QUEUE 4
+
+struct batch_image {
+	uint8_t *data;
+	enum gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+struct batch_decoder {
+	DARRAY(char *) paths;
+	struct batch_image images[BATCH_QUEUE];
+	os_sem_t *free_slots;
+	os_sem_t *filled_slots;
+	volatile bool stop;
+	pthread_t thread;
+};
+
+static void *batch_decoder_thread(void *data)
+{
+	struct batch_decoder *decoder = data;
+	os_set_thread_name("shaderfilter: batch decode");
+	for (size_t i = 0; i < decoder->paths.num; i++) {
+		os_sem_wait(decoder->free_slots);
+		if (decoder->stop)
+			break;
+		struct batch_image *image = &decoder->images[i % BATCH_QUEUE];
+		image->data = gs_create_texture_file_data(decoder->paths.array[i], &image->format, &image->cx, &image->cy);
+		os_sem_post(decoder->filled_slots);
+	}
+	return NULL;
+}
+
+// Graphics context held. Renders one input image through the filter into its output_texrender.
+static void batch_render_frame(struct shader_filter_data *filter, const struct batch_image *image, float seconds)
+{
+	const uint8_t *levels[1] = {image->data};
+	gs_texture_t *texture = gs_texture_create(image->cx, image->cy, image->format, 1, levels, 0);
+	if (!texture)
+		return;
+
+	offline_draw_input(filter, texture, image->cx, image->cy);
+	offline_advance_time(filter, seconds);
+	render_shader(filter, 0.0f, NULL);
+	gpu_timer_end_frame(filter);
+	output_capture_frame(filter);
+	gs_texture_destroy(texture);
+}
+
+static volatile long batch_renders_running = 0;
+
+// Renders every input image of the options and returns whether all of them were written.
+static bool batch_render(obs_data_t *options, long *frames_rendered)
+{
+	obs_data_set_default_string(options, "name", "frame");
+	obs_data_set_default_string(options, "format", "png");
+	obs_data_set_default_double(options, "fps", 30.0);
+	const char *shader = obs_data_get_string(options, "shader");
+	const char *output = obs_data_get_string(options, "output");
+	const double fps = obs_data_get_double(options, "fps") > 0.0 ? obs_data_get_double(options, "fps") : 30.0;
+
+	// The paths stay owned by the glob until the end.
+	struct batch_decoder decoder = {0};
+	os_glob_t *glob = NULL;
+	if (os_glob(obs_data_get_string(options, "input"), 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++) {
+			if (!glob->gl_pathv[i].directory)
+				da_push_back(decoder.paths, &glob->gl_pathv[i].path);
+		}
+	} else {
+		glob = NULL;
+	}
+	if (!*shader || !*output || !decoder.paths.num) {
+		blog(LOG_WARNING, "[obs-shaderfilter] Batch render needs a shader, an output folder and input images");
+		if (glob)
+			os_globfree(glob);
+		da_free(decoder.paths);
+		return false;
+	}
+	os_mkdirs(output);
+
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *shader_settings = obs_data_get_obj(options, "settings");
+	if (shader_settings)
+		obs_data_apply(settings, shader_settings);
+	obs_data_release(shader_settings);
+	const char *extension = strrchr(shader, '.');
+	obs_data_set_bool(settings, "from_file", true);
+	obs_data_set_string(settings, "shader_file_name", shader);
+	obs_data_set_bool(settings, "override_entire_effect", extension && astrcmpi(extension, ".effect") == 0);
+	// Compiled here instead of by a deferred update on the video thread, which would race render_shader below.
+	obs_data_set_bool(settings, "offline", true);
+	obs_source_t *source = obs_source_create_private("shader_filter", "shader batch render", settings);
+	obs_data_release(settings);
+	struct shader_filter_data *filter = source ? obs_obj_get_data(source) : NULL;
+
+	long frames = 0;
+	bool success = false;
+	if (filter && filter->effect) {
+		const uint64_t start = os_gettime_ns();
+		struct output_capture *capture = output_capture_create(
+			output, obs_data_get_string(options, "name"),
+			strcmp(obs_data_get_string(options, "format"), "raw") != 0, 1);
+		capture->lossless = true;
+		filter->capture = capture;
+
+		os_sem_init(&decoder.free_slots, BATCH_QUEUE);
+		os_sem_init(&decoder.filled_slots, 0);
+		const bool decoding = pthread_create(&decoder.thread, NULL, batch_decoder_thread, &decoder) == 0;
+		for (size_t i = 0; decoding && i < decoder.paths.num; i++) {
+			os_sem_wait(decoder.filled_slots);
+			struct batch_image *image = &decoder.images[i % BATCH_QUEUE];
+			obs_enter_graphics();
+			if (image->data) {
+				batch_render_frame(filter, image, (float)(1.0 / fps));
+				frames++;
+			} else {
+				blog(LOG_WARNING, "[obs-shaderfilter] Batch render could not read %s", decoder.paths.array[i]);
+			}
+			obs_leave_graphics();
+			bfree(image->data);
+			image->data = NULL;
+			os_sem_post(decoder.free_slots);
+		}
+		if (decoding) {
+			decoder.stop = true;
+			os_sem_post(decoder.free_slots);
+			pthread_join(decoder.thread, NULL);
+		}
+		os_sem_destroy(decoder.free_slots);
+		os_sem_destroy(decoder.filled_slots);
+
+		obs_enter_graphics();
+		output_capture_flush(capture);
+		filter->capture = NULL;
+		obs_leave_graphics();
+		success = decoding && frames == (long)decoder.paths.num && !os_atomic_load_long(&capture->dropped);
+		// Waits for the encoder to finish writing.
+		output_capture_destroy(capture);
+		blog(LOG_INFO, "[obs-shaderfilter] Batch rendered %ld frames of %s in %.2f s", frames, shader,
+		     (double)(os_gettime_ns() - start) / 1000000000.0);
+	} else {
+		blog(LOG_WARNING, "[obs-shaderfilter] Batch render could not load shader %s", shader);
+	}
+	obs_source_release(source);
+
+	os_globfree(glob);
+	da_free(decoder.paths);
+	*frames_rendered = frames;
+	return success;
+}
+
+static void *batch_render_thread(void *data)
+{
+	obs_data_t *options = data;
+	os_set_thread_name("shaderfilter: batch render");
+	long frames = 0;
+	const bool success = batch_render(options, &frames);
+
+	struct calldata cd;
+	calldata_init(&cd);
+	calldata_set_string(&cd, "output", obs_data_get_string(options, "output"));
+	calldata_set_int(&cd, "frames", frames);
+	calldata_set_bool(&cd, "success", success);
+	signal_handler_signal(obs_get_signal_handler(), "shader_filter_batch_render_done", &cd);
+	calldata_free(&cd);
+	obs_data_release(options);
+	os_atomic_dec_long(&batch_renders_running);
+	return NULL;
+}
+
+// Proc handler: void shader_filter_batch_render(in string options, out bool started)
+// Options (JSON): {"shader": "path", "settings": {...}, "input": "folder/*.png", "output": "folder", "name": "frame",
+// "format": "png" or "raw", "fps": 30}
+// Returns right away, started is false when the options can not be read. The result is signalled as
+// void shader_filter_batch_render_done(string output, int frames, bool success) on the global signal handler.
+static void shader_filter_batch_render_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	const char *options_json = calldata_string(cd, "options");
+	obs_data_t *options = options_json && *options_json ? obs_data_create_from_json(options_json) : NULL;
+	calldata_set_bool(cd, "started", false);
+	if (!options)
+		return;
+
+	os_atomic_inc_long(&batch_renders_running);
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, batch_render_thread, options) == 0) {
+		pthread_detach(thread);
+		calldata_set_bool(cd, "started", true);
+	} else {
+		blog(LOG_ERROR, "[obs-shaderfilter] Unable to start batch render thread");
+		obs_data_release(options);
+		os_atomic_dec_long(&batch_renders_running);
+	}
+}
+
+// Proc handler: void shader_filter_convert(in string glsl, out string hlsl, out bool converted, out bool compiled,
+// out string errors, out int convert_us)
+// Runs the GLSL converter without a filter and compiles the result with the effect template, for checking conversions
+// from scripts.
+static void shader_filter_convert_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	struct dstr text = {0};
+	dstr_copy(&text, calldata_string(cd, "glsl"));
+	const uint64_t start = os_gettime_ns();
+	const bool converted = text.len && convert_shader_text(&text);
+	calldata_set_int(cd, "convert_us", (long long)((os_gettime_ns() - start) / 1000));
+	calldata_set_bool(cd, "converted", converted);
+	calldata_set_string(cd, "hlsl", converted ? text.array : "");
+
+	bool compiled = false;
+	char *errors = NULL;
+	if (converted) {
+		struct dstr effect_text = {0};
+		dstr_copy(&effect_text, effect_template_begin);
+		dstr_cat_dstr(&effect_text, &text);
+		dstr_cat(&effect_text, effect_template_end);
+		obs_enter_graphics();
+		prepare_effect_text(&effect_text);
+		gs_effect_t *effect = gs_effect_create(effect_text.array, NULL, &errors);
+		compiled = effect != NULL;
+		gs_effect_destroy(effect);
+		obs_leave_graphics();
+		dstr_free(&effect_text);
+	}
+	calldata_set_bool(cd, "compiled", compiled);
+	calldata_set_string(cd, "errors", errors ? errors : "");
+	bfree(errors);
+	dstr_free(&text);
+}
+
+static struct shader_filter_data *find_filter_by_name(const char *name)
+{
+	struct shader_filter_data *found = NULL;
+	pthread_mutex_lock(&filter_registry_mutex);
+	for (size_t i = 0; !found && i < filter_registry.num; i++) {
+		if (strcmp(obs_source_get_name(filter_registry.array[i]->context), name) == 0)
+			found = filter_registry.array[i];
+	}
+	if (found)
+		found = obs_source_get_ref(found->context) ? found : NULL;
+	pthread_mutex_unlock(&filter_registry_mutex);
+	return found;
+}
+
+// Proc handler: void shader_filter_deterministic(in bool enable, in int fps, in int seed)
+static void shader_filter_deterministic_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	deterministic_set(calldata_bool(cd, "enable"), (uint32_t)calldata_int(cd, "fps"), (uint64_t)calldata_int(cd, "seed"));
+}
+
+static void shader_filter_input_stream_proc(calldata_t *cd, bool record)
+{
+	struct shader_filter_data *filter = find_filter_by_name(calldata_string(cd, "name"));
+	bool success = false;
+	if (filter) {
+		success = input_stream_open(filter, calldata_string(cd, "path"), record);
+		obs_source_release(filter->context);
+	}
+	calldata_set_bool(cd, "success", success);
+}
+
+// Proc handler: void shader_filter_record(in string name, in string path, out bool success)
+static void shader_filter_record_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	shader_filter_input_stream_proc(cd, true);
+}
+
+// Proc handler: void shader_filter_replay(in string name, in string path, out bool success)
+static void shader_filter_replay_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	shader_filter_input_stream_proc(cd, false);
+}
+
+// Proc handler: void shader_filter_trace(in bool enable, in int threshold_ms)
+static void shader_filter_trace_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	const long long threshold_ms = calldata_int(cd, "threshold_ms");
+	trace_set_enabled(calldata_bool(cd, "enable"), threshold_ms > 0 ? (uint64_t)threshold_ms * 1000000ULL : 0);
+}
+
+// Proc handler: void shader_filter_trace_dump(out string path)
+static void shader_filter_trace_dump_proc(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	struct trace_snapshot *snapshot = trace_snapshot_create();
+	if (snapshot && trace_snapshot_write(snapshot))
+		calldata_set_string(cd, "path", snapshot->path);
+	else
+		calldata_set_string(cd, "path", "");
+	if (snapshot)
+		trace_snapshot_destroy(snapshot);
+}
+
+// Optional module settings in the plugin config directory, e.g. {"trace": true, "trace_threshold_ms": 50},
+// {"deterministic": true, "deterministic_fps": 60, "deterministic_seed": 1}, {"lazy_compile": true} or
+// {"evict_after_s": 300, "evict_effects": true, "vram_budget_mb": 1024}.
+static void load_module_config(void)
+{
+	char *path = obs_module_config_path("config.json");
+	obs_data_t *config = path ? obs_data_create_from_json_file_safe(path, "bak") : NULL;
+	bfree(path);
+	if (!config)
+		return;
+	const long long threshold_ms = obs_data_get_int(config, "trace_threshold_ms");
+	if (obs_data_get_bool(config, "trace"))
+		trace_set_enabled(true, threshold_ms > 0 ? (uint64_t)threshold_ms * 1000000ULL : 0);
+	if (obs_data_get_bool(config, "deterministic"))
+		deterministic_set(true, (uint32_t)obs_data_get_int(config, "deterministic_fps"),
+				  (uint64_t)obs_data_get_int(config, "deterministic_seed"));
+	obs_data_set_default_bool(config, "lazy_compile_idle", true);
+	lazy_compile = obs_data_get_bool(config, "lazy_compile");
+	lazy_compile_idle = obs_data_get_bool(config, "lazy_compile_idle");
+	const long long evict_after_s = obs_data_get_int(config, "evict_after_s");
+	evict_after_ns = evict_after_s > 0 ? (uint64_t)evict_after_s * 1000000000ULL : 0;
+	evict_effects = obs_data_get_bool(config, "evict_effects");
+	const long long vram_budget_mb = obs_data_get_int(config, "vram_budget_mb");
+	vram_budget = vram_budget_mb > 0 ? (uint64_t)vram_budget_mb * 1024 * 1024 : 0;
+	if (vram_budget)
+		blog(LOG_INFO, "[obs-shaderfilter] VRAM budget %lld MB", vram_budget_mb);
+	obs_data_release(config);
+}
+
 bool obs_module_load(void)
 {
 	blog(LOG_INFO, "[obs-shaderfilter] loaded version %s", PROJECT_VERSION);
 	obs_register_source(&shader_filter);
 	obs_register_source(&shader_transition);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_get_stats(out string json)", shader_filter_get_stats_proc,
+			 NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_trace(in bool enable, in int threshold_ms)",
+			 shader_filter_trace_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_trace_dump(out string path)", shader_filter_trace_dump_proc,
+			 NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_benchmark(in string options, out bool started)",
+			 shader_filter_benchmark_proc, NULL);
+	signal_handler_add(obs_get_signal_handler(), "void shader_filter_benchmark_done(string path, bool passed)");
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_instance_benchmark(in string options, out bool started)",
+			 shader_filter_instance_benchmark_proc, NULL);
+	signal_handler_add(obs_get_signal_handler(), "void shader_filter_instance_benchmark_done(string path, bool passed)");
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_set_alloc_counter(in ptr counter)",
+			 shader_filter_set_alloc_counter_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(),
+			 "void shader_filter_convert(in string glsl, out string hlsl, out bool converted, out bool compiled, "
+			 "out string errors, out int convert_us)",
+			 shader_filter_convert_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_deterministic(in bool enable, in int fps, in int seed)",
+			 shader_filter_deterministic_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_record(in string name, in string path, out bool success)",
+			 shader_filter_record_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(), "void shader_filter_replay(in string name, in string path, out bool success)",
+			 shader_filter_replay_proc, NULL);
+	proc_handler_add(obs_get_proc_handler(),
+			 "void shader_filter_batch_render(in string options, out bool started)", shader_filter_batch_render_proc,
+			 NULL);
+	signal_handler_add(obs_get_signal_handler(),
+			   "void shader_filter_batch_render_done(string output, int frames, bool success)");
+	load_module_config();
 
 	return true;
 }
 
-void obs_module_unload(void) {}
+void obs_module_unload(void)
+{
+	image_cache_shutdown();
+	trace_set_enabled(false, 0);
+	while (os_atomic_load_long(&trace_dumps_running) || os_atomic_load_bool(&benchmark_running) ||
+	       os_atomic_load_long(&batch_renders_running))
+		os_sleep_ms(10);
+	da_free(filter_registry);
+}
 
 void obs_module_post_load()
 {
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+struct dstr;
+
+static inline bool is_var_char(char ch)
+{
+	return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+// Converts GLSL (Shadertoy mainImage, GLSL Sandbox main, LÖVE effect) in place. Leaves the text untouched and returns
+// false when no entry point is found.
+bool convert_shader_text(struct dstr *effect_text);
@@ -0,0 +1,135 @@
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../shader-converter.h"
+
+// Converts every tests/converter/*.glsl and compares the result with the .hlsl file next to it. An input without a
+// .hlsl file must be rejected (no entry point). Pass --update to write the current output as the expected output.
+
+#define CONVERT_RUNS 50
+
+static const char *glsl_leftovers[] = {"vec2", "vec3", "vec4", "fragColor", "fragCoord", "gl_FragColor", "gl_FragCoord",
+				       "iResolution", "iTime", "iChannel0", "texture", "Texel", "mix", "fract"};
+
+static bool contains_word(const char *text, const char *word)
+{
+	const size_t len = strlen(word);
+	for (const char *pos = strstr(text, word); pos; pos = strstr(pos + len, word)) {
+		if ((pos == text || !is_var_char(*(pos - 1))) && !is_var_char(pos[len]))
+			return true;
+	}
+	return false;
+}
+
+// Returns NULL when the converted text looks like a shader the effect template can take.
+static const char *parse_check(const char *hlsl)
+{
+	int depth[3] = {0};
+	for (const char *ch = hlsl; *ch; ch++) {
+		const int index = *ch == '(' || *ch == ')' ? 0 : *ch == '{' || *ch == '}' ? 1 : *ch == '[' || *ch == ']' ? 2 : -1;
+		if (index < 0)
+			continue;
+		depth[index] += *ch == '(' || *ch == '{' || *ch == '[' ? 1 : -1;
+		if (depth[index] < 0)
+			return "unbalanced brackets";
+	}
+	if (depth[0] || depth[1] || depth[2])
+		return "unbalanced brackets";
+	if (!strstr(hlsl, "float4 mainImage(VertData v_in) : TARGET"))
+		return "no mainImage entry point";
+	for (size_t i = 0; i < sizeof(glsl_leftovers) / sizeof(glsl_leftovers[0]); i++) {
+		if (contains_word(hlsl, glsl_leftovers[i]))
+			return glsl_leftovers[i];
+	}
+	return NULL;
+}
+
+static bool check_input(const char *glsl_path, bool update)
+{
+	char *glsl = os_quick_read_utf8_file(glsl_path);
+	if (!glsl) {
+		printf("FAIL %s: unable to read\n", glsl_path);
+		return false;
+	}
+
+	struct dstr expected_path = {0};
+	dstr_copy(&expected_path, glsl_path);
+	dstr_resize(&expected_path, expected_path.len - 4);
+	dstr_cat(&expected_path, "hlsl");
+	char *expected = os_quick_read_utf8_file(expected_path.array);
+
+	struct dstr text = {0};
+	bool converted = false;
+	uint64_t total_ns = 0;
+	for (int run = 0; run < CONVERT_RUNS; run++) {
+		dstr_copy(&text, glsl);
+		const uint64_t start = os_gettime_ns();
+		converted = convert_shader_text(&text);
+		total_ns += os_gettime_ns() - start;
+	}
+	const double convert_us = (double)total_ns / CONVERT_RUNS / 1000.0;
+
+	const char *error = NULL;
+	if (!converted) {
+		if (expected)
+			error = "no entry point found";
+	} else if ((error = parse_check(text.array)) == NULL) {
+		if (update) {
+			if (!os_quick_write_utf8_file(expected_path.array, text.array, text.len, false))
+				error = "unable to write the expected output";
+		} else if (!expected) {
+			error = "converted an input without an expected output";
+		} else if (strcmp(text.array, expected) != 0) {
+			error = "output differs from the expected output";
+		}
+	}
+
+	if (error)
+		printf("FAIL %s: %s (%.1f us)\n", glsl_path, error, convert_us);
+	else
+		printf("ok   %s (%.1f us)\n", glsl_path, convert_us);
+	if (error && converted)
+		printf("%s\n", text.array);
+
+	dstr_free(&text);
+	dstr_free(&expected_path);
+	bfree(expected);
+	bfree(glsl);
+	return error == NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <corpus directory> [--update]\n", argv[0]);
+		return 2;
+	}
+	const bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+
+	struct dstr pattern = {0};
+	dstr_copy(&pattern, argv[1]);
+	dstr_cat(&pattern, "/*.glsl");
+	os_glob_t *glob;
+	int failed = 0;
+	size_t count = 0;
+	if (os_glob(pattern.array, 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++) {
+			if (glob->gl_pathv[i].directory)
+				continue;
+			count++;
+			if (!check_input(glob->gl_pathv[i].path, update))
+				failed++;
+		}
+		os_globfree(glob);
+	}
+	dstr_free(&pattern);
+
+	if (!count) {
+		fprintf(stderr, "No .glsl files found in %s\n", argv[1]);
+		return 2;
+	}
+	printf("%zu inputs, %d failed\n", count, failed);
+	return failed ? 1 : 0;
+}
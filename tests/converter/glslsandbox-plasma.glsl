@@ -0,0 +1,13 @@
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+uniform float time;
+uniform vec2 resolution;
+
+void main()
+{
+    vec2 p = gl_FragCoord.xy / resolution.xy;
+    float v = sin(p.x * 10.0 + time) + sin(p.y * 10.0 + time) + sin((p.x + p.y) * 10.0 + time);
+    gl_FragColor = vec4(0.5 + 0.5 * sin(v), 0.5 + 0.5 * cos(v), 0.5, 1.0);
+}
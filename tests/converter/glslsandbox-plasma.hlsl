@@ -0,0 +1,13 @@
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+
+uniform float2 resolution;
+
+float4 mainImage(VertData v_in) : TARGET
+{
+    float2 p = (v_in.uv * uv_size).xy / resolution.xy;
+    float v = sin(p.x * 10.0 + elapsed_time) + sin(p.y * 10.0 + elapsed_time) + sin((p.x + p.y) * 10.0 + elapsed_time);
+    return  float4(0.5 + 0.5 * sin(v), 0.5 + 0.5 * cos(v), 0.5, 1.0);
+}
@@ -0,0 +1,7 @@
+extern number amount;
+
+vec4 effect(vec4 color, Image tex, vec2 texture_coords, vec2 screen_coords)
+{
+    vec4 pixel = Texel(tex, texture_coords);
+    return pixel * color * vec4(1.0, 1.0 - amount, 1.0 - amount, 1.0);
+}
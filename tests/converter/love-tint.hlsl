@@ -0,0 +1,7 @@
+uniform float amount;
+
+float4 mainImage(VertData v_in) : TARGET
+{
+    float4 pixel = image.Sample(textureSampler, v_in.uv);
+    return pixel * color * float4(1.0, 1.0 - amount, 1.0 - amount, 1.0);
+}
@@ -0,0 +1,6 @@
+float4 mainImage(VertData v_in) : TARGET
+{
+    float2 uv = v_in.uv;
+    float3 col = 0.5 + 0.5 * cos(elapsed_time + uv.xyx + float3(0, 2, 4));
+    return  float4(col, 1.0);
+}
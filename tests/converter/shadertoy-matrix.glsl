@@ -0,0 +1,16 @@
+mat2 rotate(float a)
+{
+    float s = sin(a);
+    float c = cos(a);
+    return mat2(c, -s, s, c);
+}
+
+void mainImage(out vec4 fragColor, in vec2 fragCoord)
+{
+    vec2 uv = (fragCoord - 0.5 * iResolution.xy) / iResolution.y;
+    mat2 r = rotate(iTime);
+    uv = r * uv;
+    float d = length(uv);
+    float ring = smoothstep(0.02, 0.0, abs(d - 0.3));
+    fragColor = vec4(vec3(ring) * vec3(uv, 0.5 + 0.5 * sin(atan(uv.y, uv.x) * 6.0)), 1.0);
+}
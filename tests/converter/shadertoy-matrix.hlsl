@@ -0,0 +1,19 @@
+#ifndef OPENGL
+#define mat2 float2x2
+#endif
+mat2 rotate(float a)
+{
+    float s = sin(a);
+    float c = cos(a);
+    return mat2(c, -s, s, c);
+}
+
+float4 mainImage(VertData v_in) : TARGET
+{
+    float2 uv = ((v_in.uv * uv_size) - 0.5 * uv_size) / uv_size.y;
+    mat2 r = rotate(elapsed_time);
+    uv = mul(r , uv);
+    float d = length(uv);
+    float ring = smoothstep(0.02, 0.0, abs(d - 0.3));
+    return  float4(float3(ring,ring,ring) * float3(uv, 0.5 + 0.5 * sin(atan2(uv.y, uv.x) * 6.0)), 1.0);
+}
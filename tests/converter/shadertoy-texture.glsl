@@ -0,0 +1,13 @@
+#define STRENGTH 0.02
+
+vec2 wobble(vec2 uv, float t)
+{
+    return uv + vec2(sin(uv.y * 20.0 + t), cos(uv.x * 20.0 + t)) * STRENGTH;
+}
+
+void mainImage( out vec4 fragColor, in vec2 fragCoord )
+{
+    vec2 uv = fragCoord.xy / iResolution.xy;
+    vec4 c = texture(iChannel0, wobble(uv, iTime));
+    fragColor = mix(c, vec4(1.0) - c, step(0.5, fract(iTime * 0.25)));
+}
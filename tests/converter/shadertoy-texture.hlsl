@@ -0,0 +1,13 @@
+#define STRENGTH 0.02
+
+float2 wobble(float2 uv, float t)
+{
+    return uv + float2(sin(uv.y * 20.0 + t), cos(uv.x * 20.0 + t)) * STRENGTH;
+}
+
+float4 mainImage(VertData v_in) : TARGET
+{
+    float2 uv = v_in.uv;
+    float4 c = image.Sample(textureSampler, wobble(uv, elapsed_time));
+    return  lerp(c, float4(1.0,1.0,1.0,1.0) - c, step(0.5, frac(elapsed_time * 0.25)));
+}
@@ -0,0 +1,59 @@
+#include <obs.h>
+#include <util/threading.h>
+#include <stdio.h>
+
+#include "headless.h"
+
+// Runs the shader_filter_batch_render proc handler in a headless libobs instance.
+// Exits with 0 when every input image was rendered and written, 1 when some were not and 2 when it could not run.
+
+struct batch_render_result {
+	os_event_t *done;
+	long long frames;
+	bool success;
+};
+
+static void batch_render_done(void *data, calldata_t *cd)
+{
+	struct batch_render_result *result = data;
+	result->frames = calldata_int(cd, "frames");
+	result->success = calldata_bool(cd, "success");
+	os_event_signal(result->done);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 5) {
+		fprintf(stderr, "Usage: %s <plugin module> <plugin data directory> <config directory> <options json>\n",
+			argv[0]);
+		return 2;
+	}
+	if (!headless_start(argv[1], argv[2], argv[3]))
+		return 2;
+
+	struct batch_render_result result = {0};
+	os_event_init(&result.done, OS_EVENT_TYPE_MANUAL);
+	signal_handler_connect(obs_get_signal_handler(), "shader_filter_batch_render_done", batch_render_done, &result);
+
+	calldata_t cd;
+	calldata_init(&cd);
+	calldata_set_string(&cd, "options", argv[4]);
+	const bool started = proc_handler_call(obs_get_proc_handler(), "shader_filter_batch_render", &cd) &&
+			     calldata_bool(&cd, "started");
+	calldata_free(&cd);
+
+	int status = 2;
+	if (started) {
+		os_event_wait(result.done);
+		printf("%lld frames rendered\n", result.frames);
+		status = result.success ? 0 : 1;
+	} else {
+		fprintf(stderr, "Unable to start the batch render, check the options JSON\n");
+	}
+
+	signal_handler_disconnect(obs_get_signal_handler(), "shader_filter_batch_render_done", batch_render_done,
+				  &result);
+	os_event_destroy(result.done);
+	headless_stop();
+	return status;
+}
@@ -0,0 +1,60 @@
+#include <obs.h>
+#include <util/threading.h>
+#include <stdio.h>
+
+#include "headless.h"
+
+// Runs the shader_filter_benchmark proc handler in a headless libobs instance, e.g. on Mesa llvmpipe in CI.
+// Exits with 0 when the benchmark passed, 1 when it found regressions and 2 when it could not run.
+
+struct benchmark_result {
+	os_event_t *done;
+	bool passed;
+	char *path;
+};
+
+static void benchmark_done(void *data, calldata_t *cd)
+{
+	struct benchmark_result *result = data;
+	result->passed = calldata_bool(cd, "passed");
+	result->path = bstrdup(calldata_string(cd, "path"));
+	os_event_signal(result->done);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s <plugin module> <plugin data directory> <config directory> [options json]\n",
+			argv[0]);
+		return 2;
+	}
+	if (!headless_start(argv[1], argv[2], argv[3]))
+		return 2;
+
+	struct benchmark_result result = {0};
+	os_event_init(&result.done, OS_EVENT_TYPE_MANUAL);
+	signal_handler_connect(obs_get_signal_handler(), "shader_filter_benchmark_done", benchmark_done, &result);
+
+	calldata_t cd;
+	calldata_init(&cd);
+	calldata_set_string(&cd, "options", argc > 4 ? argv[4] : "");
+	const bool started = proc_handler_call(obs_get_proc_handler(), "shader_filter_benchmark", &cd) &&
+			     calldata_bool(&cd, "started");
+	calldata_free(&cd);
+
+	int status = 2;
+	if (started) {
+		os_event_wait(result.done);
+		if (result.path && *result.path)
+			printf("%s\n", result.path);
+		status = result.passed ? 0 : 1;
+	} else {
+		fprintf(stderr, "Unable to start the benchmark\n");
+	}
+
+	signal_handler_disconnect(obs_get_signal_handler(), "shader_filter_benchmark_done", benchmark_done, &result);
+	os_event_destroy(result.done);
+	bfree(result.path);
+	headless_stop();
+	return status;
+}
@@ -0,0 +1,82 @@
+#include <obs.h>
+#include <obs-module.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <obs-nix-platform.h>
+#include <X11/Xlib.h>
+#endif
+
+#include "headless.h"
+
+#ifdef _WIN32
+#define GRAPHICS_MODULE "libobs-d3d11"
+#else
+#define GRAPHICS_MODULE "libobs-opengl"
+#endif
+
+#ifdef __linux__
+static Display *display = NULL;
+#endif
+
+bool headless_start(const char *plugin_path, const char *data_path, const char *config_path)
+{
+#ifdef __linux__
+	display = XOpenDisplay(NULL);
+	if (!display) {
+		fprintf(stderr, "Unable to open an X display, run under xvfb-run on machines without one\n");
+		return false;
+	}
+	obs_set_nix_platform(OBS_NIX_PLATFORM_X11_EGL);
+	obs_set_nix_platform_display(display);
+#endif
+
+	if (!obs_startup("en-US", config_path, NULL)) {
+		fprintf(stderr, "Unable to start libobs\n");
+		return false;
+	}
+
+	struct obs_video_info ovi = {0};
+	ovi.graphics_module = GRAPHICS_MODULE;
+	ovi.fps_num = 60;
+	ovi.fps_den = 1;
+	ovi.base_width = 1280;
+	ovi.base_height = 720;
+	ovi.output_width = 1280;
+	ovi.output_height = 720;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.gpu_conversion = true;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	const int video = obs_reset_video(&ovi);
+	if (video != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Unable to start %s (error %d)\n", GRAPHICS_MODULE, video);
+		headless_stop();
+		return false;
+	}
+
+	struct obs_audio_info oai = {0};
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+	obs_reset_audio(&oai);
+
+	obs_module_t *module = NULL;
+	if (obs_open_module(&module, plugin_path, data_path) != MODULE_SUCCESS || !obs_init_module(module)) {
+		fprintf(stderr, "Unable to load the plugin from %s\n", plugin_path);
+		headless_stop();
+		return false;
+	}
+	obs_post_load_modules();
+	return true;
+}
+
+void headless_stop(void)
+{
+	obs_shutdown();
+#ifdef __linux__
+	if (display)
+		XCloseDisplay(display);
+	display = NULL;
+#endif
+}
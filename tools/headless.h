@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Starts libobs without a user interface and loads the plugin module from plugin_path with its data from data_path.
+// Module config files go to config_path. On Linux an X display is needed for OpenGL, e.g. from xvfb-run.
+bool headless_start(const char *plugin_path, const char *data_path, const char *config_path);
+void headless_stop(void);
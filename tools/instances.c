@@ -0,0 +1,132 @@
+#include <obs.h>
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "headless.h"
+
+// Runs the shader_filter_instance_benchmark proc handler in a headless libobs instance, with an allocator that counts
+// the bmalloc allocations of each thread so the plugin can report them per instance.
+// Exits with 0 when every instance compiled and rendered, 1 when they did not and 2 when it could not run.
+
+// base_set_allocator is deprecated from libobs 30 on, allocations are only counted before that.
+#if LIBOBS_API_MAJOR_VER < 30
+#define COUNT_ALLOCS 1
+#endif
+
+#ifdef COUNT_ALLOCS
+// The same 32 byte alignment as the default libobs allocator.
+#define ALLOC_ALIGNMENT 32
+
+#ifdef _MSC_VER
+static __declspec(thread) long long thread_allocs = 0;
+#else
+static _Thread_local long long thread_allocs = 0;
+#endif
+
+static void *counting_malloc(size_t size)
+{
+	thread_allocs++;
+#ifdef _WIN32
+	return _aligned_malloc(size, ALLOC_ALIGNMENT);
+#else
+	void *ptr;
+	return posix_memalign(&ptr, ALLOC_ALIGNMENT, size) == 0 ? ptr : NULL;
+#endif
+}
+
+static void *counting_realloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		thread_allocs++;
+#ifdef _WIN32
+	return _aligned_realloc(ptr, size, ALLOC_ALIGNMENT);
+#else
+	return realloc(ptr, size);
+#endif
+}
+
+static void counting_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+static long long count_allocs(void)
+{
+	return thread_allocs;
+}
+#endif
+
+struct instances_result {
+	os_event_t *done;
+	bool passed;
+	char *path;
+};
+
+static void instances_done(void *data, calldata_t *cd)
+{
+	struct instances_result *result = data;
+	result->passed = calldata_bool(cd, "passed");
+	result->path = bstrdup(calldata_string(cd, "path"));
+	os_event_signal(result->done);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s <plugin module> <plugin data directory> <config directory> [options json]\n",
+			argv[0]);
+		return 2;
+	}
+#ifdef COUNT_ALLOCS
+	// Before libobs allocates anything, so every block is freed by the allocator that allocated it.
+	struct base_allocator allocator = {counting_malloc, counting_realloc, counting_free};
+	base_set_allocator(&allocator);
+#endif
+	if (!headless_start(argv[1], argv[2], argv[3]))
+		return 2;
+
+	calldata_t cd;
+	calldata_init(&cd);
+#ifdef COUNT_ALLOCS
+	long long (*counter)(void) = count_allocs;
+	calldata_set_ptr(&cd, "counter", &counter);
+	proc_handler_call(obs_get_proc_handler(), "shader_filter_set_alloc_counter", &cd);
+#else
+	fprintf(stderr, "Allocations are not counted with this libobs version\n");
+#endif
+
+	struct instances_result result = {0};
+	os_event_init(&result.done, OS_EVENT_TYPE_MANUAL);
+	signal_handler_connect(obs_get_signal_handler(), "shader_filter_instance_benchmark_done", instances_done, &result);
+
+	calldata_set_string(&cd, "options", argc > 4 ? argv[4] : "");
+	const bool started = proc_handler_call(obs_get_proc_handler(), "shader_filter_instance_benchmark", &cd) &&
+			     calldata_bool(&cd, "started");
+	calldata_free(&cd);
+
+	int status = 2;
+	if (started) {
+		os_event_wait(result.done);
+		if (result.path && *result.path)
+			printf("%s\n", result.path);
+		status = result.passed ? 0 : 1;
+	} else {
+		fprintf(stderr, "Unable to start the instance benchmark\n");
+	}
+
+	signal_handler_disconnect(obs_get_signal_handler(), "shader_filter_instance_benchmark_done", instances_done,
+				  &result);
+	os_event_destroy(result.done);
+	bfree(result.path);
+	headless_stop();
+	return status;
+}